@@ -0,0 +1,289 @@
+//
+// Host benchmarks of the driver library on the mock bus
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../lcdlib.h"
+#include "mockbus.h"
+#include "hd44780.h"
+
+#define BENCH_ITERATIONS (100)
+
+static const u32 bus_speeds[] = {100000, 400000};
+
+static const char *const transports[] = {"smbus", "burst"};
+
+//Topology names without spaces, order of lcd_topology_t
+static const char *const topologies[] = {"40x2", "20x4", "20x2", "16x4", "16x2", "16x1t1", "16x1t2", "8x2"};
+
+static const HdProfile_t *profile;
+static uint failures;
+
+typedef struct bench
+{
+    const char *name;
+    uint iterations;
+    u8 init;            //display is initialized before the benchmark
+    void (*run)(LcdDescriptor_t *lcd, uint i);
+} Bench_t;
+
+static uint _cells(const LcdDescriptor_t *lcd) {
+    return lcd->organization.columns * lcd->organization.rows;
+}
+
+static void bench_init(LcdDescriptor_t *lcd, uint i) {
+    lcdinit(lcd, lcd->organization.topology);
+}
+
+//Whole screen printed from the top left corner, different text every time
+static void bench_print(LcdDescriptor_t *lcd, uint i) {
+    char text[LCD_BUFFER_SIZE + 1];
+    uint c;
+
+    for (c = 0; c < _cells(lcd); c++)
+        text[c] = 'A' + (i + c) % 26;
+    text[c] = '\0';
+    lcdsetcursor(lcd, 0, 0);
+    lcdprint(lcd, text);
+}
+
+static void bench_flush_full(LcdDescriptor_t *lcd, uint i) {
+    uint c;
+
+    for (c = 0; c < _cells(lcd); c++)
+        lcd->raw_data[c] = 'a' + (i + c) % 26;
+    lcdflushbuffer(lcd);
+}
+
+//A clock or a counter, few cells change between frames
+static void bench_flush_sparse(LcdDescriptor_t *lcd, uint i) {
+    const uint cells = _cells(lcd);
+
+    lcd->raw_data[cells - 1] = '0' + i % 10;
+    lcd->raw_data[cells - 2] = '0' + (i / 10) % 10;
+    lcd->raw_data[cells / 2] = (i & 1) ? ':' : ' ';
+    lcdflushbuffer(lcd);
+}
+
+static void bench_flush_idle(LcdDescriptor_t *lcd, uint i) {
+    lcdflushbuffer(lcd);
+}
+
+static void bench_scrollvert(LcdDescriptor_t *lcd, uint i) {
+    char line[LCD_MAX_LINE_LENGTH];
+
+    memset(line, 'A' + i % 26, sizeof(line));
+    lcdscrollvert(lcd, line, lcd->organization.columns, i & 1);
+}
+
+static void bench_customchar(LcdDescriptor_t *lcd, uint i) {
+    u8 bitmap[8];
+    u8 r;
+
+    for (r = 0; r < 8; r++)
+        bitmap[r] = (i + r) & 0x1F;
+    lcdcustomchar(lcd, i, bitmap);
+}
+
+//Terminal mode status update, positioning and erasing in the text, last row scrolls
+static void bench_terminal(LcdDescriptor_t *lcd, uint i) {
+    char text[64];
+    int len;
+
+    lcd->term.enabled = 1;
+    len = snprintf(text, sizeof(text), "\x1b[HCPU %u%%\x1b[K\x1b[%u;1Hlog %u\n",
+                   (i * 7) % 100, lcd->organization.rows, i);
+    lcdterm_write(lcd, (const u8 *) text, len);
+    lcdsetcursor(lcd, lcd->column, lcd->row);
+    lcdflushbuffer(lcd);
+}
+
+//Calibration first, then clear and print cycles with the timing it found
+static void bench_calibrate(LcdDescriptor_t *lcd, uint i) {
+    const u32 exec_ns = lcd->timing.exec_ns;
+    int ret;
+
+    if (i == 0) {
+        ret = lcdcalibrate(lcd);
+        //bus too slow to check instruction time leaves it alone
+        if (ret || lcd->timing.exec_ns < profile->exec_ns || lcd->timing.clear_ns < profile->clear_ns ||
+            (LCD_STATUS_LEAD_BYTES * lcd->xfer.byte_ns >= LCD_EXEC_NS && lcd->timing.exec_ns != exec_ns)) {
+            fprintf(stderr, "calibration: %d, instruction: %uns, clear: %uns\n", ret,
+                    lcd->timing.exec_ns, lcd->timing.clear_ns);
+            failures++;
+        }
+        return;
+    }
+    lcdclear(lcd);
+    bench_print(lcd, i);
+}
+
+static const Bench_t benches[] = {
+        {"init",         10,               0, bench_init},
+        {"print",        BENCH_ITERATIONS, 1, bench_print},
+        {"flush_full",   BENCH_ITERATIONS, 1, bench_flush_full},
+        {"flush_sparse", BENCH_ITERATIONS, 1, bench_flush_sparse},
+        {"flush_idle",   BENCH_ITERATIONS, 1, bench_flush_idle},
+        {"scrollvert",   BENCH_ITERATIONS, 1, bench_scrollvert},
+        {"customchar",   BENCH_ITERATIONS, 1, bench_customchar},
+        {"terminal",     BENCH_ITERATIONS, 1, bench_terminal},
+        {"calibrate",    21,               1, bench_calibrate},
+};
+
+static u64 _cpu_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (u64) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * compares what emulated controller shows with what the driver thinks
+ * is on the screen, CGRAM slots the driver considers valid included
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param Hd44780_t* emulated controller
+ * @return bool true if they agree
+ *
+ */
+static bool _matches(const LcdDescriptor_t *lcd, const Hd44780_t *hd) {
+    u8 screen[LCD_DDRAM_1LINE];
+    u8 slot, r;
+
+    hd44780_screen(hd, lcd->organization.addresses, lcd->organization.columns, lcd->organization.rows, screen);
+    if (memcmp(screen, lcd->raw_data, _cells(lcd)))
+        return false;
+
+    for (slot = 0; slot < 8; slot++) {
+        if (!(lcd->cgram_valid & (1 << slot)))
+            continue;
+        for (r = 0; r < 8; r++) {
+            if ((hd->cgram_data[slot * 8 + r] ^ lcd->custom_chars[slot][r]) & 0x1F)
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * runs benchmark on a fresh display and prints one CSV row. Elapsed time
+ * ends when the controller is done with the last instruction, not when
+ * the last byte left the bus. Emulated controller on the bus checks the
+ * timing and what ends up on the screen.
+ *
+ * @param Bench_t* benchmark
+ * @param lcd_topology_t topology of the display
+ * @param u8 true for plain I2C transfers, false for SMBus byte writes
+ * @param u32 bus clock in Hz
+ * @return none
+ *
+ */
+static void bench_one(const Bench_t *bench, lcd_topology_t topo, u8 burst, u32 bus_hz) {
+    static LcdDescriptor_t lcd;
+    static MockBus_t bus;
+    static Hd44780_t hd;
+    ktime_t start, end;
+    bool match;
+    u64 cpu;
+    uint i;
+    u8 v;
+
+    memset(&lcd, 0, sizeof(lcd));
+    mockbus_init(&bus, bus_hz, burst);
+    hd44780_init(&hd, profile, pinout, ktime_get());
+    bus.device = (MockDevice_t) {hd44780_write, hd44780_read, &hd};
+    lcd.driver_data.client = &bus.client;
+    lcd.timing.bus_hz = bus_hz;
+    lcd.backlight = 1;
+    lcd.organization.topology = topo;
+    lcdsched_attach(&lcd.sched, &bus.adapter);
+    if (bench->init)
+        lcdinit(&lcd, topo);
+
+    if (ktime_after(lcd.xfer.ready_at, ktime_get()))
+        mockbus_advance(ktime_to_ns(ktime_sub(lcd.xfer.ready_at, ktime_get())));
+    memset(&bus.stats, 0, sizeof(bus.stats));
+    start = ktime_get();
+    cpu = _cpu_ns();
+
+    for (i = 0; i < bench->iterations; i++)
+        bench->run(&lcd, i);
+
+    cpu = _cpu_ns() - cpu;
+    end = ktime_get();
+    if (ktime_after(lcd.xfer.ready_at, end))
+        end = lcd.xfer.ready_at;
+    match = _matches(&lcd, &hd);
+
+    printf("%s,%s,%s,%u,%u,%llu,%llu,%llu,%llu,%llu,%lld,%u,%d,%llu\n",
+           bench->name, topologies[topo], transports[burst], bus_hz, bench->iterations,
+           (unsigned long long) bus.stats.transactions, (unsigned long long) bus.stats.bytes,
+           (unsigned long long) bus.stats.bus_ns, (unsigned long long) bus.stats.delays,
+           (unsigned long long) bus.stats.delay_ns, (long long) ktime_to_ns(ktime_sub(end, start)),
+           hd44780_violations(&hd), match, (unsigned long long) cpu);
+
+    if (!match || hd44780_violations(&hd)) {
+        fprintf(stderr, "%s %s %s %uHz:%s", bench->name, topologies[topo], transports[burst], bus_hz,
+                match ? "" : " screen differs");
+        for (v = 0; v < HD_VIOLATION_COUNT; v++) {
+            if (hd.violations[v])
+                fprintf(stderr, " %s=%u", hd_violation_names[v], hd.violations[v]);
+        }
+        fprintf(stderr, "\n");
+        failures++;
+    }
+    lcdsched_detach(&lcd.sched);
+}
+
+static bool _selected(const char *name, int argc, char **argv) {
+    int a;
+
+    if (optind >= argc)
+        return true;
+    for (a = optind; a < argc; a++) {
+        if (!strcmp(argv[a], name))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Runs every benchmark, or just those named on the command line, for every topology,
+ * transport and bus clock. Everything but cpu_ns comes from the simulated bus, so it's
+ * the same on every host and only changes with the library. Exit status is 1 if the
+ * emulated controller saw a timing violation or ended up showing something else than
+ * the driver expects.
+ */
+int main(int argc, char **argv) {
+    uint b, s;
+    u8 burst;
+    int topo, opt;
+
+    profile = hd_profiles;
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        if (opt == 'p' && hd44780_profile(optarg)) {
+            profile = hd44780_profile(optarg);
+            continue;
+        }
+        fprintf(stderr, "usage: %s [-p hd44780|slow] [benchmark...]\n", argv[0]);
+        return 2;
+    }
+
+    printf("benchmark,topology,transport,bus_hz,iterations,transactions,bytes,bus_ns,delays,delay_ns,elapsed_ns,"
+           "violations,match,cpu_ns\n");
+    for (b = 0; b < ARRAY_SIZE(benches); b++) {
+        if (!_selected(benches[b].name, argc, argv))
+            continue;
+        for (topo = LCD_TOPO_40x2; topo <= LCD_TOPO_8x2; topo++) {
+            for (burst = 0; burst < 2; burst++) {
+                for (s = 0; s < ARRAY_SIZE(bus_speeds); s++)
+                    bench_one(&benches[b], topo, burst, bus_speeds[s]);
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
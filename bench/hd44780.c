@@ -0,0 +1,388 @@
+//
+// Behavioral model of HD44780 controller behind PCF8574 expander, for host builds
+//
+
+#include <string.h>
+
+#include "hd44780.h"
+
+#define HD_RS (0)
+#define HD_RW (1)
+#define HD_E (2)
+#define HD_D4 (4)
+#define HD_PIN(hd, n) (1 << (hd)->pins[n])
+
+const char *const hd_violation_names[HD_VIOLATION_COUNT] = {
+        "busy",
+        "setup",
+        "data",
+        "pulse",
+        "poweron",
+};
+
+const HdProfile_t hd_profiles[] = {
+        //Datasheet values, oscillator at 270kHz
+        {"hd44780", 40 * NSEC_PER_MSEC, 4100 * NSEC_PER_USEC, 100 * NSEC_PER_USEC,
+                37 * NSEC_PER_USEC, 1520 * NSEC_PER_USEC, 450},
+        //Clones with oscillator at 190kHz, instructions take 42% longer
+        {"slow", 40 * NSEC_PER_MSEC, 4100 * NSEC_PER_USEC, 100 * NSEC_PER_USEC,
+                53 * NSEC_PER_USEC, 2160 * NSEC_PER_USEC, 450},
+        {NULL},
+};
+
+/**
+ * @param char* profile name
+ * @return HdProfile_t* profile, NULL if there's no such profile
+ *
+ */
+const HdProfile_t *hd44780_profile(const char *name) {
+    const HdProfile_t *profile;
+
+    for (profile = hd_profiles; profile->name; profile++) {
+        if (!strcmp(profile->name, name))
+            return profile;
+    }
+    return NULL;
+}
+
+/**
+ * powers controller on, state is the one internal reset circuit leaves:
+ * 8-bit interface, one line, display off, DDRAM cleared, increment
+ *
+ * @param Hd44780_t* controller
+ * @param HdProfile_t* timing of the controller
+ * @param uint* expander pins of RS, RW, E, BL, D4-D7
+ * @param ktime_t power on time
+ * @return none
+ *
+ */
+void hd44780_init(Hd44780_t *hd, const HdProfile_t *profile, const uint *pinout, ktime_t now) {
+    u8 p;
+
+    memset(hd, 0, sizeof(Hd44780_t));
+    hd->profile = profile;
+    for (p = 0; p < 8; p++)
+        hd->pins[p] = pinout[p];
+    hd->poweron = now;
+    hd->busy_until = now;
+    hd->eightbit = 1;
+    hd->entry = 0x02;
+    memset(hd->ddram, 0x20, HD_DDRAM_SIZE);
+}
+
+static void _hd_violation(Hd44780_t *hd, hd_violation_t violation) {
+    hd->violations[violation]++;
+}
+
+/**
+ * value of D4-D7 lines in given port state
+ *
+ * @param Hd44780_t* controller
+ * @param u8 port
+ * @return u8 nibble
+ *
+ */
+static u8 _hd_nibble(const Hd44780_t *hd, u8 port) {
+    u8 nibble = 0, b;
+
+    for (b = 0; b < 4; b++) {
+        if (port & HD_PIN(hd, HD_D4 + b))
+            nibble |= 1 << b;
+    }
+    return nibble;
+}
+
+/**
+ * moves address counter by one, DDRAM lines wrap into each other
+ *
+ * @param Hd44780_t* controller
+ * @param u8 true to increment, false to decrement
+ * @return none
+ *
+ */
+static void _hd_step(Hd44780_t *hd, u8 increment) {
+    if (hd->cgram) {
+        hd->ac = (hd->ac + (increment ? 1 : HD_CGRAM_SIZE - 1)) % HD_CGRAM_SIZE;
+    } else if (!hd->twoline) {
+        hd->ac = (hd->ac + (increment ? 1 : HD_1LINE - 1)) % HD_1LINE;
+    } else if (increment) {
+        hd->ac = (hd->ac == HD_LINE - 1) ? 0x40 : (hd->ac == 0x40 + HD_LINE - 1) ? 0x00 : hd->ac + 1;
+    } else {
+        hd->ac = (hd->ac == 0x00) ? 0x40 + HD_LINE - 1 : (hd->ac == 0x40) ? HD_LINE - 1 : hd->ac - 1;
+    }
+}
+
+/**
+ * shifts display by one position, left shift shows later addresses
+ *
+ * @param Hd44780_t* controller
+ * @param u8 true for left, false for right
+ * @return none
+ *
+ */
+static void _hd_shift(Hd44780_t *hd, u8 left) {
+    const u8 line = hd->twoline ? HD_LINE : HD_1LINE;
+
+    hd->shift = (hd->shift + (left ? 1 : line - 1)) % line;
+}
+
+/**
+ * executes an instruction
+ *
+ * @param Hd44780_t* controller
+ * @param u8 instruction
+ * @return u32 execution time in nanoseconds
+ *
+ */
+static u32 _hd_instruction(Hd44780_t *hd, u8 value) {
+    if (value & 0x80) {
+        hd->cgram = 0;
+        hd->ac = value & 0x7F;
+    } else if (value & 0x40) {
+        hd->cgram = 1;
+        hd->ac = value & 0x3F;
+    } else if (value & 0x20) {
+        hd->eightbit = (value & 0x10) ? 1 : 0;
+        hd->twoline = (value & 0x08) ? 1 : 0;
+        hd->pending = 0;
+        hd->rpending = 0;
+    } else if (value & 0x10) {
+        if (value & 0x08)
+            _hd_shift(hd, !(value & 0x04));
+        else
+            _hd_step(hd, value & 0x04);
+    } else if (value & 0x08) {
+        hd->display = value & 0x07;
+    } else if (value & 0x04) {
+        hd->entry = value & 0x03;
+    } else if (value & 0x02) {
+        hd->cgram = 0;
+        hd->ac = 0;
+        hd->shift = 0;
+        return hd->profile->clear_ns;
+    } else if (value & 0x01) {
+        memset(hd->ddram, 0x20, HD_DDRAM_SIZE);
+        hd->cgram = 0;
+        hd->ac = 0;
+        hd->shift = 0;
+        hd->entry |= 0x02;
+        return hd->profile->clear_ns;
+    }
+    return hd->profile->exec_ns;
+}
+
+/**
+ * writes data register to DDRAM or CGRAM at address counter, counter
+ * moves and display shifts as entry mode tells
+ *
+ * @param Hd44780_t* controller
+ * @param u8 data
+ * @return none
+ *
+ */
+static void _hd_writeram(Hd44780_t *hd, u8 value) {
+    if (hd->cgram)
+        hd->cgram_data[hd->ac % HD_CGRAM_SIZE] = value;
+    else
+        hd->ddram[hd->ac % HD_DDRAM_SIZE] = value;
+    _hd_step(hd, hd->entry & 0x02);
+    if (!hd->cgram && (hd->entry & 0x01))
+        _hd_shift(hd, hd->entry & 0x02);
+}
+
+/**
+ * executes complete byte written to the controller
+ *
+ * @param Hd44780_t* controller
+ * @param u8 true for data register, false for instruction
+ * @param u8 byte
+ * @param ktime_t time of the falling edge of E
+ * @return none
+ *
+ */
+static void _hd_execute(Hd44780_t *hd, u8 rs, u8 value, ktime_t now) {
+    u32 exec = hd->profile->exec_ns;
+
+    if (rs)
+        _hd_writeram(hd, value);
+    else
+        exec = _hd_instruction(hd, value);
+
+    if (hd->instructions == 0)
+        exec = max(exec, hd->profile->init1_ns);
+    else if (hd->instructions == 1)
+        exec = max(exec, hd->profile->init2_ns);
+    if (hd->instructions < 2)
+        hd->instructions++;
+    hd->busy_until = ktime_add_ns(now, exec);
+}
+
+/**
+ * data lines sampled on falling edge of E in write mode, in 4-bit mode
+ * high nibble goes first
+ *
+ * @param Hd44780_t* controller
+ * @param u8 port while E was high
+ * @param ktime_t time of the falling edge
+ * @return none
+ *
+ */
+static void _hd_latch(Hd44780_t *hd, u8 port, ktime_t now) {
+    const u8 rs = (port & HD_PIN(hd, HD_RS)) ? 1 : 0;
+    const u8 nibble = _hd_nibble(hd, port);
+
+    if (ktime_before(now, hd->busy_until))
+        _hd_violation(hd, HD_VIOLATION_BUSY);
+    if (!hd->started) {
+        hd->started = 1;
+        if (ktime_before(now, ktime_add_ns(hd->poweron, hd->profile->poweron_ns)))
+            _hd_violation(hd, HD_VIOLATION_POWERON);
+    }
+
+    if (hd->eightbit) {
+        _hd_execute(hd, rs, nibble << 4, now);
+    } else if (!hd->pending) {
+        hd->nibble = nibble;
+        hd->pending = 1;
+    } else {
+        hd->pending = 0;
+        _hd_execute(hd, rs, (hd->nibble << 4) | nibble, now);
+    }
+}
+
+/**
+ * rising edge of E in read mode, controller drives data lines with busy
+ * flag and address counter, or with RAM at address counter
+ *
+ * @param Hd44780_t* controller
+ * @param u8 port
+ * @param ktime_t time of the rising edge
+ * @return none
+ *
+ */
+static void _hd_readbegin(Hd44780_t *hd, u8 port, ktime_t now) {
+    if (hd->eightbit || !hd->rpending) {
+        if (port & HD_PIN(hd, HD_RS))
+            hd->rvalue = hd->cgram ? hd->cgram_data[hd->ac % HD_CGRAM_SIZE] : hd->ddram[hd->ac % HD_DDRAM_SIZE];
+        else
+            hd->rvalue = (ktime_before(now, hd->busy_until) ? 0x80 : 0) | (hd->ac & 0x7F);
+        hd->output = hd->rvalue >> 4;
+    } else {
+        hd->output = hd->rvalue & 0x0F;
+    }
+}
+
+/**
+ * falling edge of E in read mode, address counter moves once whole byte
+ * of RAM was read
+ *
+ * @param Hd44780_t* controller
+ * @param u8 port while E was high
+ * @return none
+ *
+ */
+static void _hd_readend(Hd44780_t *hd, u8 port) {
+    if (!hd->eightbit && !hd->rpending) {
+        hd->rpending = 1;
+        return;
+    }
+    hd->rpending = 0;
+    if (port & HD_PIN(hd, HD_RS))
+        _hd_step(hd, hd->entry & 0x02);
+}
+
+/**
+ * byte latched by the expander, edges of E are decoded and checked
+ * against timing of the controller
+ *
+ * @param void* controller
+ * @param u8 port
+ * @param ktime_t when port changed
+ * @return none
+ *
+ */
+void hd44780_write(void *priv, u8 port, ktime_t now) {
+    Hd44780_t *hd = priv;
+    const u8 prev = hd->port;
+    const u8 enable = HD_PIN(hd, HD_E);
+    const u8 ctrl = HD_PIN(hd, HD_RS) | HD_PIN(hd, HD_RW);
+    const u8 data = HD_PIN(hd, HD_D4) | HD_PIN(hd, HD_D4 + 1) | HD_PIN(hd, HD_D4 + 2) | HD_PIN(hd, HD_D4 + 3);
+
+    hd->port = port;
+    if (!(prev & enable) && (port & enable)) {
+        if ((prev ^ port) & ctrl)
+            _hd_violation(hd, HD_VIOLATION_SETUP);
+        hd->e_rise = now;
+        if (port & HD_PIN(hd, HD_RW))
+            _hd_readbegin(hd, port, now);
+    } else if ((prev & enable) && !(port & enable)) {
+        if ((prev ^ port) & (ctrl | data))
+            _hd_violation(hd, HD_VIOLATION_DATA);
+        if (ktime_before(now, ktime_add_ns(hd->e_rise, hd->profile->enable_ns)))
+            _hd_violation(hd, HD_VIOLATION_PULSE);
+        if (prev & HD_PIN(hd, HD_RW))
+            _hd_readend(hd, prev);
+        else
+            _hd_latch(hd, prev, now);
+    }
+}
+
+/**
+ * port read back through the expander. Pins are quasi-bidirectional,
+ * while controller drives data lines it can pull those written high down.
+ *
+ * @param void* controller
+ * @param ktime_t time of the read
+ * @return u8 port value
+ *
+ */
+u8 hd44780_read(void *priv, ktime_t now) {
+    Hd44780_t *hd = priv;
+    u8 port = hd->port, b;
+
+    if ((port & HD_PIN(hd, HD_E)) && (port & HD_PIN(hd, HD_RW))) {
+        for (b = 0; b < 4; b++) {
+            if (!(hd->output & (1 << b)))
+                port &= ~HD_PIN(hd, HD_D4 + b);
+        }
+    }
+    return port;
+}
+
+/**
+ * renders what's visible, character codes row after row
+ *
+ * @param Hd44780_t* controller
+ * @param u8* DDRAM address of the first column of every row
+ * @param u8 number of columns
+ * @param u8 number of rows
+ * @param u8* where to store columns * rows codes
+ * @return none
+ *
+ */
+void hd44780_screen(const Hd44780_t *hd, const u8 *addresses, u8 columns, u8 rows, u8 *cells) {
+    u8 r, c, base, addr;
+
+    for (r = 0; r < rows; r++) {
+        base = addresses[r];
+        for (c = 0; c < columns; c++) {
+            addr = hd->twoline ? (base & 0x40) | (((base & 0x3F) + c + hd->shift) % HD_LINE) :
+                   (base + c + hd->shift) % HD_1LINE;
+            cells[r * columns + c] = hd->ddram[addr];
+        }
+    }
+}
+
+/**
+ * @param Hd44780_t* controller
+ * @return u32 number of timing violations of all kinds
+ *
+ */
+u32 hd44780_violations(const Hd44780_t *hd) {
+    u32 total = 0;
+    u8 v;
+
+    for (v = 0; v < HD_VIOLATION_COUNT; v++)
+        total += hd->violations[v];
+    return total;
+}
@@ -0,0 +1,85 @@
+//
+// Behavioral model of HD44780 controller behind PCF8574 expander, for host builds
+//
+
+#ifndef LCDI2C_BENCH_HD44780_H
+#define LCDI2C_BENCH_HD44780_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+#define HD_DDRAM_SIZE (0x80)        //DDRAM address space, valid addresses depend on line mode
+#define HD_CGRAM_SIZE (0x40)
+#define HD_LINE (40)                //DDRAM line in two-line mode
+#define HD_1LINE (80)               //DDRAM line in one-line mode
+
+typedef enum hd_violation {
+    HD_VIOLATION_BUSY = 0,      //write latched while previous instruction still executes
+    HD_VIOLATION_SETUP,         //RS or RW changed together with rising edge of E
+    HD_VIOLATION_DATA,          //RS, RW or data changed together with falling edge of E
+    HD_VIOLATION_PULSE,         //E high for less than enable pulse width
+    HD_VIOLATION_POWERON,       //first instruction too soon after power on
+    HD_VIOLATION_COUNT,
+} hd_violation_t;
+
+extern const char *const hd_violation_names[HD_VIOLATION_COUNT];
+
+/*
+  Timing of a controller, execution time starts at the falling edge of E which completes
+  an instruction. First two instructions after power on take longer, the controller
+  is initialized by them and busy flag can't be read yet.
+*/
+typedef struct hd_profile
+{
+    const char *name;
+    u32 poweron_ns;     //power on to the first instruction
+    u32 init1_ns;       //first instruction
+    u32 init2_ns;       //second instruction
+    u32 exec_ns;        //regular instruction and data access
+    u32 clear_ns;       //clear display and return home
+    u32 enable_ns;      //minimal width of E pulse
+} HdProfile_t;
+
+/*
+  Controller state as seen through the expander port. Every byte latched by the expander
+  is decoded, data lines are sampled on the falling edge of E, in 4-bit mode two of them
+  make a byte. DDRAM is kept by address, so visible screen follows from line mode, display
+  shift and the row addresses of a topology.
+*/
+typedef struct hd44780
+{
+    const HdProfile_t *profile;
+    u8 pins[8];             //expander bits of RS, RW, E, BL, D4-D7, driver's pinout order
+    u8 port;                //last byte latched by the expander
+    ktime_t poweron;
+    ktime_t e_rise;         //when E went high
+    ktime_t busy_until;     //when current instruction is done
+    u8 started;             //first instruction was received
+    u8 instructions;        //executed since power on, saturates, picks initialization timing
+    u8 eightbit;            //8-bit interface, controller powers on in it
+    u8 twoline;
+    u8 pending;             //high nibble of a 4-bit write received
+    u8 nibble;
+    u8 rpending;            //high nibble of a 4-bit read given out
+    u8 rvalue;              //byte being read
+    u8 output;              //nibble driven on data lines while E is high in read mode
+    u8 entry;               //I/D and S bits of entry mode
+    u8 display;             //D, C and B bits of display control
+    u8 cgram;               //address counter points to CGRAM
+    u8 ac;
+    u8 shift;               //DDRAM line position shown in the first column
+    u8 ddram[HD_DDRAM_SIZE];
+    u8 cgram_data[HD_CGRAM_SIZE];
+    u32 violations[HD_VIOLATION_COUNT];
+} Hd44780_t;
+
+extern const HdProfile_t hd_profiles[];
+
+const HdProfile_t *hd44780_profile(const char *name);
+void hd44780_init(Hd44780_t *hd, const HdProfile_t *profile, const uint *pinout, ktime_t now);
+void hd44780_write(void *priv, u8 port, ktime_t now);
+u8 hd44780_read(void *priv, ktime_t now);
+void hd44780_screen(const Hd44780_t *hd, const u8 *addresses, u8 columns, u8 rows, u8 *cells);
+u32 hd44780_violations(const Hd44780_t *hd);
+
+#endif //LCDI2C_BENCH_HD44780_H
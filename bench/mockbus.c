@@ -0,0 +1,218 @@
+//
+// Mock I2C bus for host builds of the driver library, counts traffic and simulates time
+//
+
+#include <string.h>
+#include <errno.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+
+#include "mockbus.h"
+
+static ktime_t clock_ns;
+static MockBus_t *selected;
+
+/**
+ * prepares bus with nothing attached and no message length limit,
+ * quirks can be set afterwards
+ *
+ * @param MockBus_t* bus
+ * @param u32 bus clock in Hz
+ * @param u8 true if adapter does plain I2C messages
+ * @return none
+ *
+ */
+void mockbus_init(MockBus_t *bus, u32 bus_hz, u8 burst) {
+    memset(bus, 0, sizeof(MockBus_t));
+    bus->bus_hz = bus_hz;
+    bus->burst = burst;
+    bus->adapter.quirks = &bus->quirks;
+    bus->client.adapter = &bus->adapter;
+    bus->client.addr = 0x27;
+    mockbus_select(bus);
+}
+
+/**
+ * makes bus the one delays are charged to
+ *
+ * @param MockBus_t* bus
+ * @return none
+ *
+ */
+void mockbus_select(MockBus_t *bus) {
+    selected = bus;
+}
+
+/**
+ * moves simulated clock forward
+ *
+ * @param u64 number of nanoseconds
+ * @return none
+ *
+ */
+void mockbus_advance(u64 nsecs) {
+    clock_ns += nsecs;
+}
+
+static MockBus_t *_mockbus(const struct i2c_client *client) {
+    return container_of(client, MockBus_t, client);
+}
+
+/**
+ * bus clock runs for given number of bits
+ *
+ * @param MockBus_t* bus
+ * @param uint number of bits
+ * @return none
+ *
+ */
+static void _mockbus_clock(MockBus_t *bus, uint bits) {
+    const u64 nsecs = (u64) bits * NSEC_PER_SEC / bus->bus_hz;
+
+    bus->stats.bus_ns += nsecs;
+    mockbus_advance(nsecs);
+}
+
+/**
+ * START, or repeated START, and address byte of a message
+ *
+ * @param MockBus_t* bus
+ * @return none
+ *
+ */
+static void _mockbus_start(MockBus_t *bus) {
+    _mockbus_clock(bus, MOCK_FRAME_BITS + MOCK_BYTE_BITS);
+}
+
+/**
+ * byte written to the expander, port changes when it's acknowledged
+ *
+ * @param MockBus_t* bus
+ * @param u8 byte
+ * @return none
+ *
+ */
+static void _mockbus_latch(MockBus_t *bus, u8 data) {
+    _mockbus_clock(bus, MOCK_BYTE_BITS);
+    bus->stats.bytes++;
+    if (bus->device.write)
+        bus->device.write(bus->device.priv, data, clock_ns);
+}
+
+/**
+ * byte read from the expander, port is sampled when the byte starts
+ *
+ * @param MockBus_t* bus
+ * @return u8 port value
+ *
+ */
+static u8 _mockbus_port(MockBus_t *bus) {
+    const u8 port = bus->device.read ? bus->device.read(bus->device.priv, clock_ns) : MOCK_PORT_IDLE;
+
+    _mockbus_clock(bus, MOCK_BYTE_BITS);
+    bus->stats.bytes++;
+    return port;
+}
+
+/**
+ * SMBus receive byte, port of the expander is read back
+ *
+ * @param i2c_client* client of the bus
+ * @return int port value
+ *
+ */
+int mockbus_read(const struct i2c_client *client) {
+    MockBus_t *bus = _mockbus(client);
+
+    bus->stats.transactions++;
+    _mockbus_start(bus);
+    return _mockbus_port(bus);
+}
+
+/**
+ * SMBus send byte, latched by the expander
+ *
+ * @param i2c_client* client of the bus
+ * @param u8 byte
+ * @return int 0
+ *
+ */
+int mockbus_write(const struct i2c_client *client, u8 data) {
+    MockBus_t *bus = _mockbus(client);
+
+    bus->stats.transactions++;
+    _mockbus_start(bus);
+    _mockbus_latch(bus, data);
+    return 0;
+}
+
+/**
+ * plain I2C transfer, messages are joined by repeated START. Expander
+ * latches every byte written at the time it's acknowledged, reads
+ * return its port.
+ *
+ * @param i2c_client* client of the bus
+ * @param i2c_msg* messages
+ * @param int number of messages
+ * @return int number of messages transferred, negative error code otherwise
+ *
+ */
+int mockbus_transfer(const struct i2c_client *client, struct i2c_msg *msgs, int num) {
+    MockBus_t *bus = _mockbus(client);
+    int m;
+
+    if (!bus->burst)
+        return -EOPNOTSUPP;
+
+    for (m = 0; m < num; m++) {
+        if (!(msgs[m].flags & I2C_M_RD) && bus->quirks.max_write_len &&
+            msgs[m].len > bus->quirks.max_write_len)
+            return -EOPNOTSUPP;
+    }
+
+    bus->stats.transactions++;
+    for (m = 0; m < num; m++) {
+        _mockbus_start(bus);
+        for (u16 i = 0; i < msgs[m].len; i++) {
+            if (msgs[m].flags & I2C_M_RD)
+                msgs[m].buf[i] = _mockbus_port(bus);
+            else
+                _mockbus_latch(bus, msgs[m].buf[i]);
+        }
+    }
+    return num;
+}
+
+bool i2c_check_functionality(struct i2c_adapter *adapter, u32 func) {
+    MockBus_t *bus = container_of(adapter, MockBus_t, adapter);
+
+    return func == I2C_FUNC_I2C ? bus->burst : true;
+}
+
+int device_property_read_u32(struct device *dev, const char *propname, u32 *val) {
+    return -EINVAL;
+}
+
+ktime_t ktime_get(void) {
+    return clock_ns;
+}
+
+static void _mockbus_delay(u64 nsecs) {
+    if (selected) {
+        selected->stats.delays++;
+        selected->stats.delay_ns += nsecs;
+    }
+    mockbus_advance(nsecs);
+}
+
+void udelay(unsigned long usecs) {
+    _mockbus_delay((u64) usecs * NSEC_PER_USEC);
+}
+
+void usleep_range(unsigned long min, unsigned long max) {
+    _mockbus_delay((u64) min * NSEC_PER_USEC);
+}
+
+void msleep(unsigned int msecs) {
+    _mockbus_delay((u64) msecs * NSEC_PER_MSEC);
+}
@@ -0,0 +1,65 @@
+//
+// Mock I2C bus for host builds of the driver library, counts traffic and simulates time
+//
+
+#ifndef LCDI2C_BENCH_MOCKBUS_H
+#define LCDI2C_BENCH_MOCKBUS_H
+
+#include <linux/types.h>
+#include <linux/i2c.h>
+
+#define MOCK_FRAME_BITS (2)         //START and STOP of a transaction, or a repeated START
+#define MOCK_BYTE_BITS (9)          //Data bits and ACK of every byte, address byte included
+#define MOCK_PORT_IDLE (0xFF)       //Port read back when no device answers, all pins pulled up
+
+/*
+  Device on the other side of the expander. It gets every byte latched on the port and
+  answers port reads. With no device attached writes go nowhere and reads return MOCK_PORT_IDLE.
+*/
+typedef struct mock_device
+{
+    void (*write)(void *priv, u8 port, ktime_t now);
+    u8 (*read)(void *priv, ktime_t now);
+    void *priv;
+} MockDevice_t;
+
+typedef struct mock_stats
+{
+    u64 transactions;   //START to STOP sequences, a combined transfer is one
+    u64 bytes;          //expander bytes written and read, address bytes excluded
+    u64 bus_ns;         //time on the bus at bus clock
+    u64 delays;         //delay calls made by the library
+    u64 delay_ns;       //time asked for by those calls
+} MockStats_t;
+
+/*
+  One adapter with a single expander on it. Bus and delay time advance the simulated
+  clock returned by ktime_get(), so the library sees the time its transfers would take.
+  Delays are charged to the bus selected last.
+*/
+typedef struct mock_bus
+{
+    struct i2c_adapter adapter;
+    struct i2c_adapter_quirks quirks;
+    struct i2c_client client;
+    u32 bus_hz;
+    u8 burst;           //adapter does plain I2C messages, otherwise SMBus byte writes only
+    MockStats_t stats;
+    MockDevice_t device;
+} MockBus_t;
+
+void mockbus_init(MockBus_t *bus, u32 bus_hz, u8 burst);
+void mockbus_select(MockBus_t *bus);
+void mockbus_advance(u64 nsecs);
+int mockbus_write(const struct i2c_client *client, u8 data);
+int mockbus_read(const struct i2c_client *client);
+int mockbus_transfer(const struct i2c_client *client, struct i2c_msg *msgs, int num);
+
+#define LOWLEVEL_WRITE(client, data) mockbus_write(client, data)
+#define LOWLEVEL_READ(client) mockbus_read(client)
+#define LOWLEVEL_TRANSFER(client, msgs, num) mockbus_transfer(client, msgs, num)
+#define LOWLEVEL_BURST(client, msg) mockbus_transfer(client, msg, 1)
+#define LOWLEVEL_LOCK(client) ((void) (client))
+#define LOWLEVEL_UNLOCK(client) ((void) (client))
+
+#endif //LCDI2C_BENCH_MOCKBUS_H
@@ -0,0 +1,13 @@
+#ifndef LCDI2C_BENCH_SHIM_ATOMIC_H
+#define LCDI2C_BENCH_SHIM_ATOMIC_H
+
+typedef struct {
+    int counter;
+} atomic_t;
+
+#define atomic_read(v) ((v)->counter)
+#define atomic_set(v, i) ((v)->counter = (i))
+#define atomic_inc(v) ((v)->counter++)
+#define atomic_dec(v) ((v)->counter--)
+
+#endif //LCDI2C_BENCH_SHIM_ATOMIC_H
@@ -0,0 +1,45 @@
+#ifndef LCDI2C_BENCH_SHIM_BITMAP_H
+#define LCDI2C_BENCH_SHIM_BITMAP_H
+
+#include <string.h>
+#include <linux/types.h>
+
+#define BITS_PER_LONG (8 * sizeof(long))
+#define BITS_TO_LONGS(nr) DIV_ROUND_UP(nr, BITS_PER_LONG)
+#define DECLARE_BITMAP(name, bits) unsigned long name[BITS_TO_LONGS(bits)]
+
+static inline bool test_bit(long nr, const unsigned long *addr) {
+    return (addr[nr / BITS_PER_LONG] >> (nr % BITS_PER_LONG)) & 1;
+}
+
+static inline void set_bit(long nr, unsigned long *addr) {
+    addr[nr / BITS_PER_LONG] |= 1UL << (nr % BITS_PER_LONG);
+}
+
+static inline void clear_bit(long nr, unsigned long *addr) {
+    addr[nr / BITS_PER_LONG] &= ~(1UL << (nr % BITS_PER_LONG));
+}
+
+static inline bool __test_and_set_bit(long nr, unsigned long *addr) {
+    bool old = test_bit(nr, addr);
+
+    set_bit(nr, addr);
+    return old;
+}
+
+static inline unsigned long find_first_zero_bit(const unsigned long *addr, unsigned long size) {
+    unsigned long i;
+
+    for (i = 0; i < size && test_bit(i, addr); i++);
+    return i;
+}
+
+static inline void bitmap_zero(unsigned long *dst, unsigned int nbits) {
+    memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+#define for_each_set_bit(bit, addr, size) \
+    for ((bit) = 0; (bit) < (size); (bit)++) \
+        if (test_bit(bit, addr))
+
+#endif //LCDI2C_BENCH_SHIM_BITMAP_H
@@ -0,0 +1,10 @@
+#ifndef LCDI2C_BENCH_SHIM_BITOPS_H
+#define LCDI2C_BENCH_SHIM_BITOPS_H
+
+#include <linux/types.h>
+
+static inline int fls64(u64 x) {
+    return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+#endif //LCDI2C_BENCH_SHIM_BITOPS_H
@@ -0,0 +1 @@
+#include <stdlib.h>
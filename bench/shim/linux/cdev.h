@@ -0,0 +1,8 @@
+#ifndef LCDI2C_BENCH_SHIM_CDEV_H
+#define LCDI2C_BENCH_SHIM_CDEV_H
+
+struct cdev {
+    int count;
+};
+
+#endif //LCDI2C_BENCH_SHIM_CDEV_H
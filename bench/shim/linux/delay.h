@@ -0,0 +1,11 @@
+#ifndef LCDI2C_BENCH_SHIM_DELAY_H
+#define LCDI2C_BENCH_SHIM_DELAY_H
+
+#include <linux/types.h>
+
+//Delays don't wait, they advance the simulated clock of the mock bus
+void udelay(unsigned long usecs);
+void usleep_range(unsigned long min, unsigned long max);
+void msleep(unsigned int msecs);
+
+#endif //LCDI2C_BENCH_SHIM_DELAY_H
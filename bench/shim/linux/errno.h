@@ -0,0 +1,2 @@
+//Same values as the kernel, what uapi linux/errno.h provides
+#include <asm/errno.h>
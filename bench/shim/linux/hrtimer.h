@@ -0,0 +1,15 @@
+#ifndef LCDI2C_BENCH_SHIM_HRTIMER_H
+#define LCDI2C_BENCH_SHIM_HRTIMER_H
+
+#include <linux/ktime.h>
+
+enum hrtimer_restart {
+    HRTIMER_NORESTART,
+    HRTIMER_RESTART,
+};
+
+struct hrtimer {
+    enum hrtimer_restart (*function)(struct hrtimer *);
+};
+
+#endif //LCDI2C_BENCH_SHIM_HRTIMER_H
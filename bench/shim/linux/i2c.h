@@ -0,0 +1,47 @@
+#ifndef LCDI2C_BENCH_SHIM_I2C_H
+#define LCDI2C_BENCH_SHIM_I2C_H
+
+#include <linux/types.h>
+
+#define I2C_M_RD (0x0001)
+#define I2C_M_TEN (0x0010)
+#define I2C_FUNC_I2C (0x00000001)
+
+struct device {
+    struct device *parent;
+};
+
+struct i2c_adapter_quirks {
+    u16 max_write_len;
+};
+
+struct i2c_adapter {
+    const struct i2c_adapter_quirks *quirks;
+    struct device dev;
+};
+
+struct i2c_client {
+    unsigned short flags;
+    unsigned short addr;
+    struct i2c_adapter *adapter;
+    struct device dev;
+};
+
+struct i2c_msg {
+    u16 addr;
+    u16 flags;
+    u16 len;
+    u8 *buf;
+};
+
+//Provided by the mock bus, see bench/mockbus.c
+bool i2c_check_functionality(struct i2c_adapter *adapter, u32 func);
+int device_property_read_u32(struct device *dev, const char *propname, u32 *val);
+
+#define dev_err(dev, ...) ((void) (dev))
+#define dev_warn(dev, ...) ((void) (dev))
+#define dev_info(dev, ...) ((void) (dev))
+#define dev_dbg(dev, ...) ((void) (dev))
+#define dev_err_ratelimited(dev, ...) ((void) (dev))
+
+#endif //LCDI2C_BENCH_SHIM_I2C_H
@@ -0,0 +1,11 @@
+#ifndef LCDI2C_BENCH_SHIM_KFIFO_H
+#define LCDI2C_BENCH_SHIM_KFIFO_H
+
+struct kfifo {
+    unsigned int in;
+    unsigned int out;
+    unsigned int mask;
+    void *data;
+};
+
+#endif //LCDI2C_BENCH_SHIM_KFIFO_H
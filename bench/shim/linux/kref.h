@@ -0,0 +1,13 @@
+#ifndef LCDI2C_BENCH_SHIM_KREF_H
+#define LCDI2C_BENCH_SHIM_KREF_H
+
+#include <linux/atomic.h>
+
+struct kref {
+    atomic_t refcount;
+};
+
+#define kref_init(kref) atomic_set(&(kref)->refcount, 1)
+#define kref_get(kref) atomic_inc(&(kref)->refcount)
+
+#endif //LCDI2C_BENCH_SHIM_KREF_H
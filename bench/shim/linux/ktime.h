@@ -0,0 +1,23 @@
+#ifndef LCDI2C_BENCH_SHIM_KTIME_H
+#define LCDI2C_BENCH_SHIM_KTIME_H
+
+#include <linux/types.h>
+
+#define KTIME_MAX ((s64) ~((u64) 1 << 63))
+
+#define ktime_add_ns(kt, nsval) ((kt) + (s64) (nsval))
+#define ktime_add_us(kt, usval) ((kt) + (s64) (usval) * NSEC_PER_USEC)
+#define ktime_add_ms(kt, msval) ((kt) + (s64) (msval) * NSEC_PER_MSEC)
+#define ktime_sub(a, b) ((a) - (b))
+#define ktime_to_ns(kt) (kt)
+#define ktime_to_us(kt) ((kt) / NSEC_PER_USEC)
+#define ns_to_ktime(ns) ((ktime_t) (ns))
+#define ms_to_ktime(ms) ((ktime_t) (ms) * NSEC_PER_MSEC)
+#define ktime_before(a, b) ((a) < (b))
+#define ktime_after(a, b) ((a) > (b))
+#define ktime_compare(a, b) ((a) < (b) ? -1 : (a) > (b))
+
+//Simulated clock of the mock bus
+ktime_t ktime_get(void);
+
+#endif //LCDI2C_BENCH_SHIM_KTIME_H
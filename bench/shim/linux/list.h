@@ -0,0 +1,45 @@
+#ifndef LCDI2C_BENCH_SHIM_LIST_H
+#define LCDI2C_BENCH_SHIM_LIST_H
+
+#include <linux/types.h>
+
+struct list_head {
+    struct list_head *next, *prev;
+};
+
+#define LIST_HEAD(name) struct list_head name = {&(name), &(name)}
+
+static inline void INIT_LIST_HEAD(struct list_head *list) {
+    list->next = list->prev = list;
+}
+
+static inline void __list_add(struct list_head *entry, struct list_head *prev, struct list_head *next) {
+    next->prev = entry;
+    entry->next = next;
+    entry->prev = prev;
+    prev->next = entry;
+}
+
+static inline void list_add(struct list_head *entry, struct list_head *head) {
+    __list_add(entry, head, head->next);
+}
+
+static inline void list_add_tail(struct list_head *entry, struct list_head *head) {
+    __list_add(entry, head->prev, head);
+}
+
+static inline void list_del(struct list_head *entry) {
+    entry->next->prev = entry->prev;
+    entry->prev->next = entry->next;
+}
+
+static inline bool list_empty(const struct list_head *head) {
+    return head->next == head;
+}
+
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+#define list_for_each_entry(pos, head, member) \
+    for (pos = list_entry((head)->next, __typeof__(*pos), member); &pos->member != (head); \
+         pos = list_entry(pos->member.next, __typeof__(*pos), member))
+
+#endif //LCDI2C_BENCH_SHIM_LIST_H
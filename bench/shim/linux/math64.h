@@ -0,0 +1,14 @@
+#ifndef LCDI2C_BENCH_SHIM_MATH64_H
+#define LCDI2C_BENCH_SHIM_MATH64_H
+
+#include <linux/types.h>
+
+static inline u64 div_u64(u64 dividend, u32 divisor) {
+    return dividend / divisor;
+}
+
+static inline u64 div64_u64(u64 dividend, u64 divisor) {
+    return dividend / divisor;
+}
+
+#endif //LCDI2C_BENCH_SHIM_MATH64_H
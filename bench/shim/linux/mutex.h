@@ -0,0 +1,13 @@
+#ifndef LCDI2C_BENCH_SHIM_MUTEX_H
+#define LCDI2C_BENCH_SHIM_MUTEX_H
+
+struct mutex {
+    int locked;
+};
+
+#define DEFINE_MUTEX(name) struct mutex name = {0}
+#define mutex_init(lock) ((lock)->locked = 0)
+#define mutex_lock(lock) ((lock)->locked++)
+#define mutex_unlock(lock) ((lock)->locked--)
+
+#endif //LCDI2C_BENCH_SHIM_MUTEX_H
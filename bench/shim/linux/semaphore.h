@@ -0,0 +1,8 @@
+#ifndef LCDI2C_BENCH_SHIM_SEMAPHORE_H
+#define LCDI2C_BENCH_SHIM_SEMAPHORE_H
+
+struct semaphore {
+    int count;
+};
+
+#endif //LCDI2C_BENCH_SHIM_SEMAPHORE_H
@@ -0,0 +1,14 @@
+#ifndef LCDI2C_BENCH_SHIM_SEQLOCK_H
+#define LCDI2C_BENCH_SHIM_SEQLOCK_H
+
+typedef struct {
+    unsigned int sequence;
+} seqlock_t;
+
+#define seqlock_init(sl) ((sl)->sequence = 0)
+#define write_seqlock(sl) ((sl)->sequence++)
+#define write_sequnlock(sl) ((sl)->sequence++)
+#define read_seqbegin(sl) ((sl)->sequence)
+#define read_seqretry(sl, start) ((sl)->sequence != (start))
+
+#endif //LCDI2C_BENCH_SHIM_SEQLOCK_H
@@ -0,0 +1,19 @@
+#ifndef LCDI2C_BENCH_SHIM_SLAB_H
+#define LCDI2C_BENCH_SHIM_SLAB_H
+
+#include <stdlib.h>
+#include <linux/types.h>
+
+static inline void *kmalloc(size_t size, gfp_t flags) {
+    return malloc(size);
+}
+
+static inline void *kzalloc(size_t size, gfp_t flags) {
+    return calloc(1, size);
+}
+
+static inline void kfree(const void *ptr) {
+    free((void *) ptr);
+}
+
+#endif //LCDI2C_BENCH_SHIM_SLAB_H
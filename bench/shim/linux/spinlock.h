@@ -0,0 +1,13 @@
+#ifndef LCDI2C_BENCH_SHIM_SPINLOCK_H
+#define LCDI2C_BENCH_SHIM_SPINLOCK_H
+
+//Bench is single threaded, locks only have to compile
+typedef struct {
+    int locked;
+} spinlock_t;
+
+#define spin_lock_init(lock) ((lock)->locked = 0)
+#define spin_lock(lock) ((lock)->locked++)
+#define spin_unlock(lock) ((lock)->locked--)
+
+#endif //LCDI2C_BENCH_SHIM_SPINLOCK_H
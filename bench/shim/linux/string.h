@@ -0,0 +1,19 @@
+#ifndef LCDI2C_BENCH_SHIM_STRING_H
+#define LCDI2C_BENCH_SHIM_STRING_H
+
+#include <string.h>
+#include <linux/types.h>
+
+static inline bool sysfs_streq(const char *s1, const char *s2) {
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    if (*s1 == '\n')
+        s1++;
+    if (*s2 == '\n')
+        s2++;
+    return !*s1 && !*s2;
+}
+
+#endif //LCDI2C_BENCH_SHIM_STRING_H
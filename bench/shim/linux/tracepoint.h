@@ -0,0 +1,17 @@
+#ifndef LCDI2C_BENCH_SHIM_TRACEPOINT_H
+#define LCDI2C_BENCH_SHIM_TRACEPOINT_H
+
+#include <linux/types.h>
+
+//Tracepoints compile to nothing and are never enabled
+#define TP_PROTO(...) __VA_ARGS__
+#define TP_ARGS(...) __VA_ARGS__
+
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args) \
+    static inline void trace_##name(proto) {} \
+    static inline bool trace_##name##_enabled(void) { return false; }
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print) \
+    DEFINE_EVENT(name, name, TP_PROTO(proto), TP_ARGS(args))
+
+#endif //LCDI2C_BENCH_SHIM_TRACEPOINT_H
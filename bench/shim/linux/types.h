@@ -0,0 +1,50 @@
+//
+// Userspace stand-in for the kernel API used by the driver library, bench build only
+//
+
+#ifndef LCDI2C_BENCH_SHIM_TYPES_H
+#define LCDI2C_BENCH_SHIM_TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <linux/errno.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef unsigned int uint;
+typedef unsigned int gfp_t;
+typedef s64 ktime_t;
+
+#define __user
+#define GFP_KERNEL (0)
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min_t(t, a, b) ((t) (a) < (t) (b) ? (t) (a) : (t) (b))
+#define max_t(t, a, b) ((t) (a) > (t) (b) ? (t) (a) : (t) (b))
+#define clamp_t(t, v, lo, hi) min_t(t, max_t(t, v, lo), hi)
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define BIT(n) (1UL << (n))
+#define DIV_ROUND_UP(a, b) (((a) + (b) - 1) / (b))
+#define container_of(ptr, type, member) ((type *) ((char *) (ptr) - offsetof(type, member)))
+#define likely(x) (x)
+#define unlikely(x) (x)
+#define fallthrough __attribute__((fallthrough))
+#define READ_ONCE(x) (x)
+#define WRITE_ONCE(x, v) ((x) = (v))
+
+#define NSEC_PER_USEC (1000L)
+#define NSEC_PER_MSEC (1000000L)
+#define NSEC_PER_SEC (1000000000L)
+#define USEC_PER_MSEC (1000L)
+#define USEC_PER_SEC (1000000L)
+
+#endif //LCDI2C_BENCH_SHIM_TYPES_H
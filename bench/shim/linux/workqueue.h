@@ -0,0 +1,14 @@
+#ifndef LCDI2C_BENCH_SHIM_WORKQUEUE_H
+#define LCDI2C_BENCH_SHIM_WORKQUEUE_H
+
+struct workqueue_struct;
+
+struct work_struct {
+    void (*func)(struct work_struct *);
+};
+
+struct delayed_work {
+    struct work_struct work;
+};
+
+#endif //LCDI2C_BENCH_SHIM_WORKQUEUE_H
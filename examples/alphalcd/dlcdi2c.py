@@ -1,5 +1,6 @@
 import array
 import fcntl
+import os
 import struct
 
 import yaml
@@ -20,8 +21,24 @@ SET_CUSTOMCHAR = "SETCUSTOMCHAR"
 CLEAR = "CLEAR"
 SET_POSITION = "SETPOSITION"
 GET_POSITION = "GETPOSITION"
+SET_WINDOW = "SETWINDOW"
 
-META_FILE_PATH = "/sys/class/alphalcd/lcdi2c/meta"
+CLASS_PATH = "/sys/class/alphalcd"
+DEVICE_PREFIX = "lcdi2c"
+
+
+def device_name(bus: int = None, address: int = None) -> str:
+    """
+    Returns name of the display device at given bus and address, as used in /dev and /sys/class/alphalcd.
+    Without bus and address returns the first display registered by the driver.
+    """
+    if bus is not None and address is not None:
+        return f"{DEVICE_PREFIX}-{bus}-{address:02x}"
+    try:
+        names = sorted(n for n in os.listdir(CLASS_PATH) if n.startswith(f"{DEVICE_PREFIX}-"))
+    except FileNotFoundError:
+        names = []
+    return names[0] if names else None
 
 RDWR = 3
 WRITE = 1
@@ -45,24 +62,23 @@ class LcdI2C:
         self.bus = bus
         self.address = address
 
+        name = device_name(bus, address)
+        if name is None:
+            raise LcdI2CInitError(f"No display found in {CLASS_PATH} (is the lcdi2c module loaded?)")
+        self.meta_path = f"{CLASS_PATH}/{name}/meta"
+        self.device_path = f"/dev/{name}"
+
         try:
-            with open(META_FILE_PATH) as meta:
+            with open(self.meta_path) as meta:
                 p = yaml.safe_load(meta)
                 self.columns = p["metadata"]["columns"]
                 self.rows = p["metadata"]["rows"]
                 self.bufferlength = self.columns * self.rows
                 self.ioctls = p["metadata"]["ioctls"]
-                if not (bus or address):
-                    self.bus = p["metadata"]["busno"]
-                    self.address = p["metadata"]["reg"]
+                self.bus = p["metadata"]["busno"]
+                self.address = p["metadata"]["reg"]
         except FileNotFoundError:
-            raise LcdI2CInitError(f"Metadata file not found at {META_FILE_PATH}")
-
-        try:
-            with open(f"/sys/bus/i2c/devices/{self.bus}-{self.address:04x}/name") as f:
-                self.device_path = f"/dev/{f.read().strip()}"
-        except FileNotFoundError:
-            raise LcdI2CInitError(f"Device not found at bus {self.bus} address {self.address}")
+            raise LcdI2CInitError(f"Metadata file not found at {self.meta_path}")
 
     @staticmethod
     def __cmdparse(cmd):
@@ -113,6 +129,11 @@ class LcdI2C:
         if self.file:
             self.closed = False
 
+    def close(self):
+        if not self.closed:
+            self.file.close()
+        self.closed = True
+
     def write(self, data):
         return self.file.write(data) if not self.closed else 0
 
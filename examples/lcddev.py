@@ -8,8 +8,8 @@ import time
 from alphalcd.dlcdi2c import (
     LcdI2C,
     LcdI2CInitError,
-    GET_POSITION,
     SET_POSITION,
+    SET_WINDOW,
     SET_CUSTOMCHAR,
     SET_BACKLIGHT,
     SET_BLINK,
@@ -61,34 +61,32 @@ def get_core_load(interval, cores):
 
 class LcdThread(threading.Thread):
     """
-    Base class of all threads
+    Base class of all threads. Every thread opens the display on its own and claims
+    a window of the screen, so threads write to their windows without any locking
     """
-    threadLock = threading.RLock()
     quitEvent = threading.Event()
     barrier = threading.Barrier(2 + len(get_cpu_usage()))
 
-    def __init__(self, name: str, lcd: LcdI2C, col: int, row: int):
+    def __init__(self, name: str, lcd: LcdI2C, col: int, row: int, width: int = 1):
         super(LcdThread, self).__init__(name=f"{name}-{col}.{row}")
-        self.lcd = lcd
+        self.lcd = LcdI2C(lcd.bus, lcd.address)
+        self.lcd.open(self.lcd.device_path, "r+")
+        self.lcd.io_write(SET_WINDOW, (col, row, width, 1))
         self.col = col
         self.row = row
-        self.buff = range(9)
 
     def write(self, string):
         """
-        Write string at position given by col, row in class constructor
-        only one thread is able to write to LCD at time, other threads
-        will wait
+        Write string at the beginning of the window, cursor of the display and of
+        other threads stays where it was
         """
-        with LcdThread.threadLock:
-            self.buff = self.lcd.io_read(GET_POSITION)
-            self.lcd.io_write(SET_POSITION, (self.col, self.row))
-            self.lcd.write(string)
-            self.lcd.flush()
-            self.lcd.io_write(SET_POSITION, self.buff)
+        self.lcd.io_write(SET_POSITION, (0, 0))
+        self.lcd.write(string)
+        self.lcd.flush()
 
     def finish(self):
         print(f"{self.name}-finished")
+        self.lcd.close()
         self.barrier.wait()
 
 
@@ -98,7 +96,7 @@ class TimeThread(LcdThread):
     """
 
     def __init__(self, lcd: LcdI2C, col: int, row: int):
-        super(TimeThread, self).__init__("TimeThread", lcd, col, row)
+        super(TimeThread, self).__init__("TimeThread", lcd, col, row, 8)
 
     def run(self):
         while LcdThread.quitEvent.is_set() is False:
@@ -168,30 +166,24 @@ class SystemLoad:
 
     def __init__(self, lcd, col, row):
         self.cores = len(get_cpu_usage())
-        self.buffer = range(9)
         self.col = col
         self.row = row
-        self.lcd = lcd
-        self.threads = []
         self.string = "CPU:"
-        self.write(self.string)
+        self.lcd = LcdI2C(lcd.bus, lcd.address)
+        self.lcd.open(self.lcd.device_path, "r+")
+        self.lcd.io_write(SET_WINDOW, (col, row, len(self.string), 1))
+        self.threads = []
+        self.lcd.write(self.string)
+        self.lcd.flush()
+        self.lcd.close()
         for i in range(1, self.cores):
             self.threads.append(
-                SystemLoadThread(i, self.lcd, len(self.string) + self.col + (i - 1), self.row, self.cores))
+                SystemLoadThread(i, lcd, len(self.string) + self.col + (i - 1), self.row, self.cores))
 
     def start(self):
-        lcd.io_write(SET_POSITION, (self.col, self.row))
         for i in range(self.cores - 1):
             self.threads[i].start()
 
-    def write(self, string):
-        with LcdThread.threadLock:
-            self.buffer = self.lcd.io_read(GET_POSITION)
-            self.lcd.io_write(SET_POSITION, (self.col, self.row))
-            self.lcd.write(string)
-            self.lcd.flush()
-            self.lcd.io_write(SET_POSITION, self.buffer)
-
 
 class ScrollingThread(LcdThread):
     """
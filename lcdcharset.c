@@ -0,0 +1,319 @@
+//
+// Character sets, UTF-8 text translated to codes of HD44780 character ROM
+//
+
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/bsearch.h>
+
+#include "lcdlib.h"
+
+typedef struct lcd_rom_char
+{
+    u16 codepoint;
+    u8 code;
+} LcdRomChar_t;
+
+typedef struct lcd_fallback_char
+{
+    u16 codepoint;
+    CustomChar_t bitmap;
+} LcdFallbackChar_t;
+
+/*
+  A00 ROM beyond ASCII, sorted by code point. Half-width katakana are mapped by range.
+  Backslash and tilde have yen sign and right arrow in their places, they come from
+  the fallback font.
+*/
+static const LcdRomChar_t a00rom[] = {
+        {0x00A2, 0xEC}, //¢
+        {0x00A3, 0xED}, //£
+        {0x00A5, 0x5C}, //¥
+        {0x00B0, 0xDF}, //° as handakuten
+        {0x00B5, 0xE4}, //µ
+        {0x00B7, 0xA5}, //·
+        {0x00DF, 0xE2}, //ß as beta
+        {0x00E4, 0xE1}, //ä
+        {0x00F1, 0xEE}, //ñ
+        {0x00F6, 0xEF}, //ö
+        {0x00F7, 0xFD}, //÷
+        {0x00FC, 0xF5}, //ü
+        {0x0398, 0xF2}, //Θ
+        {0x03A3, 0xF6}, //Σ
+        {0x03A9, 0xF4}, //Ω
+        {0x03B1, 0xE0}, //α
+        {0x03B2, 0xE2}, //β
+        {0x03B5, 0xE3}, //ε
+        {0x03B8, 0xF2}, //θ
+        {0x03BC, 0xE4}, //μ
+        {0x03C0, 0xF7}, //π
+        {0x03C1, 0xE6}, //ρ
+        {0x03C3, 0xE5}, //σ
+        {0x2190, 0x7F}, //←
+        {0x2192, 0x7E}, //→
+        {0x221A, 0xE8}, //√
+        {0x221E, 0xF3}, //∞
+        {0x2588, 0xFF}, //█
+        {0x3001, 0xA4}, //、
+        {0x3002, 0xA1}, //。
+        {0x300C, 0xA2}, //「
+        {0x300D, 0xA3}, //」
+        {0x30FB, 0xA5}, //・
+        {0x30FC, 0xB0}, //ー
+        {0x4E07, 0xFB}, //万
+        {0x5186, 0xFC}, //円
+        {0x5343, 0xFA}, //千
+};
+
+/*
+  A02 ROM beyond ASCII, sorted by code point. Upper half follows Latin-1 and is mapped
+  by range, Cyrillic capitals which look like Latin ones share their codes.
+*/
+static const LcdRomChar_t a02rom[] = {
+        {0x0393, 0x92}, //Γ
+        {0x0398, 0x99}, //Θ
+        {0x03A3, 0x94}, //Σ
+        {0x03A9, 0x9A}, //Ω
+        {0x03B1, 0x90}, //α
+        {0x03B4, 0x9B}, //δ
+        {0x03B5, 0x9E}, //ε
+        {0x03C0, 0x93}, //π
+        {0x03C3, 0x95}, //σ
+        {0x03C4, 0x97}, //τ
+        {0x0410, 'A'},  //А
+        {0x0411, 0x80}, //Б
+        {0x0412, 'B'},  //В
+        {0x0414, 0x81}, //Д
+        {0x0415, 'E'},  //Е
+        {0x0416, 0x82}, //Ж
+        {0x0417, 0x83}, //З
+        {0x0418, 0x84}, //И
+        {0x0419, 0x85}, //Й
+        {0x041A, 'K'},  //К
+        {0x041B, 0x86}, //Л
+        {0x041C, 'M'},  //М
+        {0x041D, 'H'},  //Н
+        {0x041E, 'O'},  //О
+        {0x041F, 0x87}, //П
+        {0x0420, 'P'},  //Р
+        {0x0421, 'C'},  //С
+        {0x0422, 'T'},  //Т
+        {0x0423, 0x88}, //У
+        {0x0425, 'X'},  //Х
+        {0x0426, 0x89}, //Ц
+        {0x0427, 0x8A}, //Ч
+        {0x0428, 0x8B}, //Ш
+        {0x0429, 0x8C}, //Щ
+        {0x042A, 0x8D}, //Ъ
+        {0x042B, 0x8E}, //Ы
+        {0x042D, 0x8F}, //Э
+        {0x201C, 0x12}, //“
+        {0x201D, 0x13}, //”
+        {0x2190, 0x1B}, //←
+        {0x2191, 0x18}, //↑
+        {0x2192, 0x1A}, //→
+        {0x2193, 0x19}, //↓
+        {0x21B5, 0x17}, //↵
+        {0x221E, 0x9C}, //∞
+        {0x2229, 0x9F}, //∩
+        {0x2264, 0x1C}, //≤
+        {0x2265, 0x1D}, //≥
+        {0x2302, 0x7F}, //⌂
+        {0x25B2, 0x1E}, //▲
+        {0x25B6, 0x10}, //▶
+        {0x25BC, 0x1F}, //▼
+        {0x25C0, 0x11}, //◀
+        {0x25CF, 0x16}, //●
+        {0x2665, 0x9D}, //♥
+        {0x266A, 0x91}, //♪
+        {0x266C, 0x96}, //♬
+};
+
+/*
+  Glyphs of characters missing in one ROM or both, sorted by code point. Character is
+  looked up in the ROM first, so entries present in the selected ROM are never used.
+*/
+static const LcdFallbackChar_t fallback[] = {
+        {0x005C, {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00, 0x00}}, //backslash
+        {0x007E, {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00, 0x00}}, //~
+        {0x00C4, {0x0A, 0x00, 0x0E, 0x11, 0x1F, 0x11, 0x11, 0x00}}, //Ä
+        {0x00D6, {0x0A, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E, 0x00}}, //Ö
+        {0x00DC, {0x0A, 0x00, 0x11, 0x11, 0x11, 0x11, 0x0E, 0x00}}, //Ü
+        {0x00E0, {0x08, 0x04, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00}}, //à
+        {0x00E1, {0x02, 0x04, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00}}, //á
+        {0x00E5, {0x04, 0x0A, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00}}, //å
+        {0x00E7, {0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E, 0x04, 0x0C}}, //ç
+        {0x00E8, {0x08, 0x04, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00}}, //è
+        {0x00E9, {0x02, 0x04, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00}}, //é
+        {0x00F3, {0x02, 0x04, 0x0E, 0x11, 0x11, 0x11, 0x0E, 0x00}}, //ó
+        {0x0105, {0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x02}}, //ą
+        {0x0107, {0x02, 0x04, 0x0E, 0x10, 0x10, 0x11, 0x0E, 0x00}}, //ć
+        {0x0119, {0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x02}}, //ę
+        {0x0141, {0x10, 0x10, 0x14, 0x18, 0x10, 0x10, 0x1F, 0x00}}, //Ł
+        {0x0142, {0x0C, 0x04, 0x06, 0x0C, 0x04, 0x04, 0x0E, 0x00}}, //ł
+        {0x0144, {0x02, 0x04, 0x16, 0x19, 0x11, 0x11, 0x11, 0x00}}, //ń
+        {0x015B, {0x02, 0x04, 0x0E, 0x10, 0x0E, 0x01, 0x1E, 0x00}}, //ś
+        {0x017A, {0x02, 0x04, 0x1F, 0x02, 0x04, 0x08, 0x1F, 0x00}}, //ź
+        {0x017C, {0x04, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F, 0x00}}, //ż
+        {0x20AC, {0x06, 0x09, 0x1C, 0x08, 0x1C, 0x09, 0x06, 0x00}}, //€
+};
+
+static int _cmpcodepoint(const void *key, const void *entry) {
+    return (int) *(const u16 *) key - (int) *(const u16 *) entry;
+}
+
+/**
+ * ROM code of a character
+ *
+ * @param u8 lcd_charset_t of the display
+ * @param u32 code point
+ * @return int character code, negative if ROM hasn't got the character
+ *
+ */
+static int _romcode(u8 mode, u32 codepoint) {
+    const LcdRomChar_t *found;
+    u16 key = codepoint;
+
+    if (codepoint < 0x80)
+        return (mode == LCD_CHARSET_A00 && (codepoint == '\\' || codepoint == '~')) ? -1 : codepoint;
+    if (codepoint > 0xFFFF)
+        return -1;
+
+    if (mode == LCD_CHARSET_A00) {
+        if (codepoint >= 0xFF61 && codepoint <= 0xFF9F)
+            return 0xA1 + (codepoint - 0xFF61);
+        found = bsearch(&key, a00rom, ARRAY_SIZE(a00rom), sizeof(LcdRomChar_t), _cmpcodepoint);
+    } else {
+        if (codepoint >= 0xA0 && codepoint <= 0xFF)
+            return codepoint;
+        found = bsearch(&key, a02rom, ARRAY_SIZE(a02rom), sizeof(LcdRomChar_t), _cmpcodepoint);
+    }
+    return found ? found->code : -1;
+}
+
+/**
+ * @param u32 code point
+ * @return u8* fallback glyph of a character, NULL if there's none
+ *
+ */
+static const u8 *_fallbackglyph(u32 codepoint) {
+    const LcdFallbackChar_t *found;
+    u16 key = codepoint;
+
+    if (codepoint > 0xFFFF)
+        return NULL;
+    found = bsearch(&key, fallback, ARRAY_SIZE(fallback), sizeof(LcdFallbackChar_t), _cmpcodepoint);
+    return found ? found->bitmap : NULL;
+}
+
+/**
+ * @param char* character set name
+ * @return int lcd_charset_t of the name, -EINVAL if it's unknown
+ *
+ */
+int lcdcharset_parse(const char *name) {
+    int mode;
+
+    for (mode = 0; mode < LCD_CHARSET_COUNT; mode++) {
+        if (sysfs_streq(name, charsetnames[mode]))
+            return mode;
+    }
+    return -EINVAL;
+}
+
+/**
+ * selects character set, incomplete UTF-8 sequence is dropped
+ *
+ * @param LcdCharset_t* translation state
+ * @param lcd_charset_t character set
+ * @return none
+ *
+ */
+void lcdcharset_set(LcdCharset_t *charset, lcd_charset_t mode) {
+    memset(charset, 0, sizeof(LcdCharset_t));
+    charset->mode = mode;
+}
+
+/**
+ * translates UTF-8 text into character codes of the ROM. Characters
+ * missing in the ROM get CGRAM slots with fallback glyphs, all glyphs of
+ * the text are mapped at once so they don't evict each other. Invalid
+ * sequences and characters which can't be shown are replaced. Incomplete
+ * sequence at the end of the text is kept for the next call.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8* UTF-8 text
+ * @param uint number of bytes of text
+ * @param u8* where to store character codes
+ * @param uint room in cells, LCD_BUFFER_SIZE at most is used
+ * @param uint* where to store number of bytes of text consumed
+ * @return uint number of character codes stored
+ *
+ */
+uint lcdcharset_translate(LcdDescriptor_t *lcd, const u8 *src, uint len, u8 *cells, uint size, uint *used) {
+    LcdCharset_t *state = &lcd->charset;
+    const u8 *bitmaps[LCD_GLYPH_SLOTS];
+    u8 glyph[LCD_BUFFER_SIZE], codes[LCD_GLYPH_SLOTS];
+    uint i, n = 0, pending = 0, k;
+    const u8 *bitmap;
+    u32 codepoint;
+    int code;
+    u8 byte;
+
+    size = min_t(uint, size, LCD_BUFFER_SIZE);
+    for (i = 0; i < len && n < size; i++) {
+        byte = src[i];
+
+        if (state->need) {
+            if ((byte & 0xC0) == 0x80) {
+                state->codepoint = (state->codepoint << 6) | (byte & 0x3F);
+                if (--state->need)
+                    continue;
+                codepoint = state->codepoint;
+                if (codepoint < state->min || codepoint > 0x10FFFF ||
+                    (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+                    codepoint = 0xFFFD;
+            } else {
+                //broken sequence is replaced, the byte is taken again as a new one
+                state->need = 0;
+                codepoint = 0xFFFD;
+                i--;
+            }
+        } else if (byte < 0x80) {
+            codepoint = byte;
+        } else if (byte >= 0xC2 && byte <= 0xF4) {
+            state->need = byte < 0xE0 ? 1 : byte < 0xF0 ? 2 : 3;
+            state->min = byte < 0xE0 ? 0x80 : byte < 0xF0 ? 0x800 : 0x10000;
+            state->codepoint = byte & (0x3F >> state->need);
+            continue;
+        } else {
+            codepoint = 0xFFFD;
+        }
+
+        glyph[n] = 0xFF;
+        code = _romcode(state->mode, codepoint);
+        if (code < 0) {
+            code = LCD_CHARSET_REPLACEMENT;
+            bitmap = _fallbackglyph(codepoint);
+            if (bitmap) {
+                for (k = 0; k < pending && bitmaps[k] != bitmap; k++);
+                if (k == pending && pending < LCD_GLYPH_SLOTS)
+                    bitmaps[pending++] = bitmap;
+                if (k < pending)
+                    glyph[n] = k;
+            }
+        }
+        cells[n++] = code;
+    }
+    *used = i;
+
+    if (pending) {
+        if (lcdglyph_mapbitmaps(lcd, bitmaps, pending, codes))
+            memset(codes, LCD_CHARSET_REPLACEMENT, sizeof(codes));
+        for (k = 0; k < n; k++) {
+            if (glyph[k] != 0xFF)
+                cells[k] = codes[glyph[k]];
+        }
+    }
+    return n;
+}
@@ -0,0 +1,44 @@
+//
+// Character sets, UTF-8 text translated to codes of HD44780 character ROM
+//
+
+#ifndef LCDI2C_LCDCHARSET_H
+#define LCDI2C_LCDCHARSET_H
+
+#include <linux/types.h>
+
+#define LCD_CHARSET_REPLACEMENT ('?')   //shown for what neither ROM nor CGRAM can show
+
+typedef enum lcd_charset {
+    LCD_CHARSET_RAW = 0,        //bytes go to the LCD as they are
+    LCD_CHARSET_A00,            //UTF-8, Japanese ROM with katakana
+    LCD_CHARSET_A02,            //UTF-8, European ROM with Latin-1, Greek and Cyrillic
+    LCD_CHARSET_COUNT,
+} lcd_charset_t;
+
+__attribute__ ((unused)) static const char *charsetnames[] = {
+        "raw",
+        "a00",
+        "a02",
+};
+
+/*
+  Translation state of a display. UTF-8 sequence split between two writes is completed
+  by the next one. Characters missing in the ROM are shown by CGRAM glyphs of the built-in
+  fallback font, loaded on demand through the glyph table.
+*/
+typedef struct lcd_charset_state
+{
+    u8 mode;                    //lcd_charset_t
+    u8 need;                    //continuation bytes missing in the current sequence
+    u32 codepoint;              //code point decoded so far
+    u32 min;                    //smallest code point of the sequence length, shorter form is invalid
+} LcdCharset_t;
+
+struct LcdDescriptor_t;
+
+int lcdcharset_parse(const char *name);
+void lcdcharset_set(LcdCharset_t *charset, lcd_charset_t mode);
+uint lcdcharset_translate(struct LcdDescriptor_t *lcd, const u8 *src, uint len, u8 *cells, uint size, uint *used);
+
+#endif //LCDI2C_LCDCHARSET_H
@@ -0,0 +1,306 @@
+//
+// Timer driven effects, custom character animations and marquees
+//
+
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+
+#include "lcdlib.h"
+
+/**
+ * loads, starts or stops animation of a CGRAM slot. Started animation
+ * shows its first frame on the next step.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param LcdAnimationArgs_t* animation command
+ * @return int 0 on success, -EINVAL if command is invalid
+ *
+ */
+int lcdeffects_animate(LcdDescriptor_t *lcd, const LcdAnimationArgs_t *args) {
+    LcdEffects_t *effects = &lcd->effects;
+    LcdAnimation_t *anim;
+    u8 i;
+
+    if (args->slot >= 8)
+        return -EINVAL;
+    anim = &effects->animations[args->slot];
+
+    switch (args->command) {
+        case LCD_ANIMATION_STOP:
+            effects->animated &= ~(1 << args->slot);
+            return 0;
+        case LCD_ANIMATION_LOAD:
+            if (!args->frames || args->frames > LCD_ANIMATION_FRAMES)
+                return -EINVAL;
+            memcpy(anim->bitmaps, args->bitmaps, sizeof(anim->bitmaps));
+            for (i = 0; i < LCD_ANIMATION_FRAMES; i++)
+                anim->duration_ms[i] = max_t(u16, args->duration_ms[i], LCD_ANIMATION_MIN_MS);
+            anim->frames = args->frames;
+            break;
+        case LCD_ANIMATION_START:
+            if (!anim->frames)
+                return -EINVAL;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    anim->frame = 0;
+    anim->loops = args->loops;
+    anim->loops_left = args->loops;
+    anim->due = ktime_get();
+    effects->animated |= 1 << args->slot;
+    return 0;
+}
+
+/**
+ * starts marquee of a row, or stops it if text is empty. Text is taken
+ * over by the marquee, it's freed when marquee stops.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param LcdMarqueeArgs_t* row, direction and speed of the marquee
+ * @param u8* text allocated by kmalloc, NULL to stop the marquee
+ * @return int 0 on success, -EINVAL if arguments are invalid
+ *
+ */
+int lcdeffects_marquee(LcdDescriptor_t *lcd, const LcdMarqueeArgs_t *args, u8 *text) {
+    LcdEffects_t *effects = &lcd->effects;
+    LcdMarquee_t *marquee;
+
+    if (args->row >= lcd->organization.rows || args->length > LCD_MARQUEE_MAX_TEXT ||
+        (args->length && !text))
+        return -EINVAL;
+    marquee = &effects->marquees[args->row];
+
+    kfree(marquee->text);
+    memset(marquee, 0, sizeof(LcdMarquee_t));
+    effects->scrolling &= ~(1 << args->row);
+    if (!args->length)
+        return 0;
+
+    marquee->text = text;
+    marquee->length = args->length;
+    marquee->period = max_t(u16, args->length, lcd->organization.columns);
+    marquee->step_ms = max_t(u16, args->step_ms, LCD_MARQUEE_MIN_MS);
+    marquee->direction = args->direction ? 1 : 0;
+    marquee->due = ktime_get();
+    effects->scrolling |= 1 << args->row;
+    return 0;
+}
+
+/**
+ * stops all animations and marquees, what's shown at the moment stays
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+void lcdeffects_stop(LcdDescriptor_t *lcd) {
+    LcdEffects_t *effects = &lcd->effects;
+    u8 r;
+
+    effects->animated = 0;
+    for (r = 0; r < LCD_MARQUEE_ROWS; r++) {
+        kfree(effects->marquees[r].text);
+        effects->marquees[r].text = NULL;
+    }
+    effects->scrolling = 0;
+}
+
+/**
+ * character of marquee text shown in given column
+ *
+ * @param LcdMarquee_t* marquee
+ * @param uint column
+ * @return u8 character
+ *
+ */
+static u8 _marqueecell(const LcdMarquee_t *marquee, uint column) {
+    const u16 i = (marquee->offset + column) % marquee->period;
+
+    return i < marquee->length ? marquee->text[i] : ' ';
+}
+
+/**
+ * moves marquee text by one column
+ *
+ * @param LcdMarquee_t* marquee
+ * @return none
+ *
+ */
+static void _marqueemove(LcdMarquee_t *marquee) {
+    marquee->offset = (marquee->offset + (marquee->direction ? marquee->period - 1 : 1)) % marquee->period;
+}
+
+/**
+ * tells whether whole screen scrolls as one, so display shift can do it:
+ * every row of a two-row display has a marquee of DDRAM line period with
+ * the same speed and direction
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return bool true if display shift can be used
+ *
+ */
+static bool _marqueeshift(LcdDescriptor_t *lcd) {
+    LcdEffects_t *effects = &lcd->effects;
+    const LcdMarquee_t *first = &effects->marquees[0];
+    u8 r;
+
+    if (lcd->organization.rows != 2 || effects->scrolling != 0x03 ||
+        (lcd->display_function & LCD_FS_2LINES) != LCD_FS_2LINES)
+        return false;
+
+    for (r = 0; r < 2; r++) {
+        const LcdMarquee_t *marquee = &effects->marquees[r];
+
+        if (marquee->period != LCD_DDRAM_LINE || marquee->step_ms != first->step_ms ||
+            marquee->direction != first->direction)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * schedules next marquee step, keeping the cadence unless bus was too
+ * slow to keep up with it
+ *
+ * @param LcdMarquee_t* marquee
+ * @param ktime_t current time
+ * @return none
+ *
+ */
+static void _marqueedue(LcdMarquee_t *marquee, ktime_t now) {
+    marquee->due = ktime_add_ms(marquee->due, marquee->step_ms);
+    if (!ktime_after(marquee->due, now))
+        marquee->due = ktime_add_ms(now, marquee->step_ms);
+}
+
+/**
+ * marquee step done by display shift. Both DDRAM lines hold whole texts,
+ * so a single shift command moves both rows. Text stays where it was put
+ * in DDRAM, so after the first step rewriting the lines sends nothing.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param ktime_t current time
+ * @return ktime_t when the next step is due
+ *
+ */
+static ktime_t _marqueeshiftstep(LcdDescriptor_t *lcd, ktime_t now) {
+    LcdMarquee_t *marquees = lcd->effects.marquees;
+    u8 cells[LCD_DDRAM_LINE];
+    u8 r, c;
+
+    if (ktime_after(marquees[0].due, now))
+        return marquees[0].due;
+
+    if (marquees[0].started)
+        lcdscrollhoriz(lcd, marquees[0].direction);
+    marquees[1].due = marquees[0].due;     //rows step together from now on
+    for (r = 0; r < 2; r++) {
+        if (marquees[r].started)
+            _marqueemove(&marquees[r]);
+        marquees[r].started = 1;
+        _marqueedue(&marquees[r], now);
+
+        for (c = 0; c < LCD_DDRAM_LINE; c++)
+            cells[c] = _marqueecell(&marquees[r], c);
+        lcdwriterow(lcd, r, 0, cells, LCD_DDRAM_LINE);
+    }
+    return marquees[0].due;
+}
+
+/**
+ * marquee steps done by rewriting rows. Every due row is rendered into
+ * raw_data, then a single flush sends cells which changed.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param ktime_t current time
+ * @return ktime_t when the next step is due
+ *
+ */
+static ktime_t _marqueestep(LcdDescriptor_t *lcd, ktime_t now) {
+    LcdEffects_t *effects = &lcd->effects;
+    const u8 columns = lcd->organization.columns;
+    ktime_t next = KTIME_MAX;
+    LcdMarquee_t *marquee;
+    u8 stepped = 0;
+    u8 r, c;
+
+    for (r = 0; r < lcd->organization.rows && r < LCD_MARQUEE_ROWS; r++) {
+        if (!(effects->scrolling & (1 << r)))
+            continue;
+        marquee = &effects->marquees[r];
+
+        if (!ktime_after(marquee->due, now)) {
+            if (marquee->started)
+                _marqueemove(marquee);
+            marquee->started = 1;
+            _marqueedue(marquee, now);
+
+            for (c = 0; c < columns; c++)
+                lcd->raw_data[r * columns + c] = _marqueecell(marquee, c);
+            stepped = 1;
+        }
+        if (ktime_before(marquee->due, next))
+            next = marquee->due;
+    }
+
+    if (stepped)
+        lcdflushbuffer(lcd);
+    return next;
+}
+
+/**
+ * shows every frame and marquee step which is due, all of them in a
+ * single bus frame.
+ * Caller has to hold the semaphore.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param ktime_t current time
+ * @return ktime_t when the next step is due, KTIME_MAX if nothing runs
+ *
+ */
+ktime_t lcdeffects_step(LcdDescriptor_t *lcd, ktime_t now) {
+    LcdEffects_t *effects = &lcd->effects;
+    ktime_t next = KTIME_MAX;
+    LcdAnimation_t *anim;
+    ktime_t due;
+    u8 slot;
+
+    lcdbegin(lcd);
+    for (slot = 0; slot < 8; slot++) {
+        if (!(effects->animated & (1 << slot)))
+            continue;
+        anim = &effects->animations[slot];
+
+        if (!ktime_after(anim->due, now)) {
+            if (anim->frame == anim->frames) {
+                if (anim->loops && !--anim->loops_left) {
+                    effects->animated &= ~(1 << slot);
+                    continue;
+                }
+                anim->frame = 0;
+            }
+            lcdcustomcharrows(lcd, slot, anim->bitmaps[anim->frame]);
+
+            //Keep the cadence, unless bus was too slow to keep up with it
+            anim->due = ktime_add_ms(anim->due, anim->duration_ms[anim->frame]);
+            if (!ktime_after(anim->due, now))
+                anim->due = ktime_add_ms(now, anim->duration_ms[anim->frame]);
+            anim->frame++;
+        }
+        if (ktime_before(anim->due, next))
+            next = anim->due;
+    }
+
+    if (effects->scrolling) {
+        due = _marqueeshift(lcd) ? _marqueeshiftstep(lcd, now) : _marqueestep(lcd, now);
+        if (ktime_before(due, next))
+            next = due;
+    }
+    lcdend(lcd);
+
+    return next;
+}
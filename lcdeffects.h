@@ -0,0 +1,89 @@
+//
+// Timer driven effects, custom character animations and marquees
+//
+
+#ifndef LCDI2C_LCDEFFECTS_H
+#define LCDI2C_LCDEFFECTS_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+#define LCD_ANIMATION_FRAMES (16)       //Frames of a single animation
+#define LCD_ANIMATION_MIN_MS (10)       //Shortest frame, so animations can't flood the bus
+#define LCD_EFFECTS_SLACK_NS (1000000)  //Timer slack, lets wakeups be coalesced with others
+#define LCD_MARQUEE_MAX_TEXT (4096)     //Longest marquee text
+#define LCD_MARQUEE_MIN_MS (50)         //Shortest marquee step
+#define LCD_MARQUEE_ROWS (4)
+
+typedef enum lcd_animation_cmd {
+    LCD_ANIMATION_STOP = 0,     //stop animation of the slot, current frame stays
+    LCD_ANIMATION_LOAD,         //load frames of the slot and start from the first one
+    LCD_ANIMATION_START,        //start frames loaded before from the first one
+} lcd_animation_cmd_t;
+
+/*
+  Frames are uploaded to the CGRAM slot by the driver, only bitmap rows which differ
+  from the previous frame go to the bus. Animation runs loops times, or forever if loops is 0.
+*/
+typedef struct lcd_animation
+{
+    u8 bitmaps[LCD_ANIMATION_FRAMES][8];
+    u16 duration_ms[LCD_ANIMATION_FRAMES];
+    u8 frames;
+    u8 frame;                   //next frame to show
+    u16 loops;
+    u16 loops_left;
+    ktime_t due;                //when next frame is shown
+} LcdAnimation_t;
+
+/*
+  Marquee scrolls text of a single row by one column per step. Text shorter than the row
+  is followed by spaces up to the row length, the text repeats after that.
+*/
+typedef struct lcd_marquee
+{
+    u8 *text;
+    u16 length;
+    u16 period;                 //text length, or row length if the text is shorter
+    u16 offset;                 //position in text shown in the first column
+    u16 step_ms;
+    u8 direction;               //0 - text moves left, 1 - right
+    u8 started;                 //first step shows the text, next ones move it
+    ktime_t due;
+} LcdMarquee_t;
+
+typedef struct lcd_effects
+{
+    LcdAnimation_t animations[8];
+    u8 animated;                //bitmask of slots with running animation
+    LcdMarquee_t marquees[LCD_MARQUEE_ROWS];
+    u8 scrolling;               //bitmask of rows with running marquee
+} LcdEffects_t;
+
+typedef struct LcdAnimationArgs_t {
+    u8 slot;                    //CGRAM slot 0-7
+    u8 command;                 //lcd_animation_cmd_t
+    u8 frames;                  //number of frames, LOAD only
+    u8 reserved;
+    u16 loops;                  //number of runs, 0 - forever
+    u8 reserved2[2];
+    u16 duration_ms[LCD_ANIMATION_FRAMES];
+    u8 bitmaps[LCD_ANIMATION_FRAMES][8];
+} LcdAnimationArgs_t;
+
+typedef struct LcdMarqueeArgs_t {
+    u8 row;
+    u8 direction;               //0 - text moves left, 1 - right
+    u16 step_ms;                //time between steps
+    u32 length;                 //text length, 0 stops marquee of the row
+    u64 text;                   //address of the text
+} LcdMarqueeArgs_t;
+
+struct LcdDescriptor_t;
+
+int lcdeffects_animate(struct LcdDescriptor_t *lcd, const LcdAnimationArgs_t *args);
+int lcdeffects_marquee(struct LcdDescriptor_t *lcd, const LcdMarqueeArgs_t *args, u8 *text);
+void lcdeffects_stop(struct LcdDescriptor_t *lcd);
+ktime_t lcdeffects_step(struct LcdDescriptor_t *lcd, ktime_t now);
+
+#endif //LCDI2C_LCDEFFECTS_H
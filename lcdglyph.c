@@ -0,0 +1,179 @@
+//
+// Virtual glyph table, bitmaps registered once and paged into the 8 CGRAM slots on use
+//
+
+#include <linux/string.h>
+#include <linux/errno.h>
+
+#include "lcdlib.h"
+
+/**
+ * registers glyph bitmap under given id, or under id picked by the table
+ * if id is negative. Picked id is the one of identical bitmap registered
+ * before, if there is one, otherwise the first free one.
+ *
+ * @param LcdGlyphTable_t* glyph table
+ * @param int glyph id 0-255, negative lets the table pick it
+ * @param u8* array of 8 bytes of bitmap definition
+ * @return int glyph id on success, negative error code otherwise
+ *
+ */
+int lcdglyph_register(LcdGlyphTable_t *table, int id, const u8 *bitmap) {
+    if (id >= LCD_GLYPH_COUNT)
+        return -EINVAL;
+
+    if (id < 0) {
+        for_each_set_bit(id, table->registered, LCD_GLYPH_COUNT) {
+            if (!memcmp(table->bitmaps[id], bitmap, 8))
+                return id;
+        }
+        id = find_first_zero_bit(table->registered, LCD_GLYPH_COUNT);
+        if (id >= LCD_GLYPH_COUNT)
+            return -ENOSPC;
+    }
+
+    memcpy(table->bitmaps[id], bitmap, 8);
+    set_bit(id, table->registered);
+    return id;
+}
+
+/**
+ * forgets registered glyph
+ *
+ * @param LcdGlyphTable_t* glyph table
+ * @param u8 glyph id
+ * @return none
+ *
+ */
+void lcdglyph_remove(LcdGlyphTable_t *table, u8 id) {
+    clear_bit(id, table->registered);
+}
+
+/**
+ * @param LcdGlyphTable_t* glyph table
+ * @param u8 glyph id
+ * @return bool true if glyph with this id is registered
+ *
+ */
+bool lcdglyph_registered(LcdGlyphTable_t *table, u8 id) {
+    return test_bit(id, table->registered);
+}
+
+/**
+ * counts distinct bitmaps among given glyphs, that's the number of
+ * CGRAM slots needed to show all of them at once
+ *
+ * @param LcdGlyphTable_t* glyph table
+ * @param u8* glyph ids
+ * @param uint number of ids
+ * @return uint number of distinct bitmaps
+ *
+ */
+uint lcdglyph_distinct(LcdGlyphTable_t *table, const u8 *ids, uint count) {
+    uint distinct = 0, i, j;
+
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < i; j++) {
+            if (!memcmp(table->bitmaps[ids[i]], table->bitmaps[ids[j]], 8))
+                break;
+        }
+        if (j == i)
+            distinct++;
+    }
+    return distinct;
+}
+
+/**
+ * makes sure bitmaps are loaded in CGRAM and gives character codes to
+ * show them. Bitmap already in a slot costs nothing, missing ones go to
+ * least recently used slots which aren't animated and whose code isn't on
+ * the screen, consecutive slots are uploaded in one auto-increment burst.
+ * Nothing is changed if there are not enough free slots.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8** bitmaps, 8 bytes each
+ * @param uint number of bitmaps
+ * @param u8* where to store character code of every bitmap
+ * @return int 0 on success, -ENOSPC if bitmaps don't fit in CGRAM
+ *
+ */
+int lcdglyph_mapbitmaps(LcdDescriptor_t *lcd, const u8 *const *bitmaps, uint count, u8 *codes) {
+    LcdGlyphTable_t *table = &lcd->glyphs;
+    const uint cells = lcd->organization.columns * lcd->organization.rows;
+    CustomChar_t staged[LCD_GLYPH_SLOTS];
+    u8 pinned, wanted = 0, load = 0;
+    uint i, s, first;
+    int victim;
+
+    //Codes 0-15 on the screen show CGRAM slots, 8-15 are aliases of 0-7,
+    //animated slots belong to their animations
+    pinned = lcd->effects.animated;
+    for (i = 0; i < cells; i++) {
+        if (lcd->raw_data[i] < 2 * LCD_GLYPH_SLOTS)
+            pinned |= 1 << (lcd->raw_data[i] & (LCD_GLYPH_SLOTS - 1));
+    }
+
+    for (i = 0; i < count; i++) {
+        const u8 *bitmap = bitmaps[i];
+
+        victim = -1;
+        for (s = 0; s < LCD_GLYPH_SLOTS; s++) {
+            if (lcd->effects.animated & (1 << s))
+                continue;
+            if ((load & (1 << s)) ? !memcmp(staged[s], bitmap, 8) :
+                ((lcd->cgram_valid & (1 << s)) && !memcmp(lcd->custom_chars[s], bitmap, 8)))
+                break;
+            if ((pinned | wanted) & (1 << s))
+                continue;
+            if (victim < 0 || table->slot_used[s] < table->slot_used[victim])
+                victim = s;
+        }
+
+        if (s == LCD_GLYPH_SLOTS) {
+            if (victim < 0)
+                return -ENOSPC;
+            s = victim;
+            memcpy(staged[s], bitmap, 8);
+            load |= 1 << s;
+        }
+        wanted |= 1 << s;
+        codes[i] = s;
+    }
+
+    table->clock++;
+    for (s = 0; s < LCD_GLYPH_SLOTS; s++) {
+        if (wanted & (1 << s))
+            table->slot_used[s] = table->clock;
+    }
+
+    for (s = 0; s < LCD_GLYPH_SLOTS; s++) {
+        if (!(load & (1 << s)))
+            continue;
+        for (first = s; s + 1 < LCD_GLYPH_SLOTS && (load & (1 << (s + 1))); s++);
+        lcdcustomchars(lcd, first, s - first + 1, staged + first);
+    }
+
+    return 0;
+}
+
+/**
+ * makes sure registered glyphs are loaded in CGRAM, see lcdglyph_mapbitmaps.
+ * Glyph already in a slot, under any id, costs nothing.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8* registered glyph ids
+ * @param uint number of ids, LCD_GLYPH_MAP_MAX at most
+ * @param u8* where to store character code of every glyph
+ * @return int 0 on success, -ENOSPC if glyphs don't fit in CGRAM
+ *
+ */
+int lcdglyph_map(LcdDescriptor_t *lcd, const u8 *ids, uint count, u8 *codes) {
+    const u8 *bitmaps[LCD_GLYPH_MAP_MAX];
+    uint i;
+
+    if (count > LCD_GLYPH_MAP_MAX)
+        return -EINVAL;
+    for (i = 0; i < count; i++)
+        bitmaps[i] = lcd->glyphs.bitmaps[ids[i]];
+    return lcdglyph_mapbitmaps(lcd, bitmaps, count, codes);
+}
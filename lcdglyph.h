@@ -0,0 +1,48 @@
+//
+// Virtual glyph table, bitmaps registered once and paged into the 8 CGRAM slots on use
+//
+
+#ifndef LCDI2C_LCDGLYPH_H
+#define LCDI2C_LCDGLYPH_H
+
+#include <linux/types.h>
+#include <linux/bitmap.h>
+
+#define LCD_GLYPH_COUNT (256)
+#define LCD_GLYPH_SLOTS (8)             //CGRAM slots of 5x8 characters
+#define LCD_GLYPH_MAP_MAX (84)          //most glyphs mapped at once, a whole screen
+
+//Flags of SETGLYPH ioctl
+#define LCD_GLYPH_AUTO (1 << 0)         //driver picks the id, identical bitmap already registered is reused
+#define LCD_GLYPH_REMOVE (1 << 1)       //forget the glyph, slot it occupies is kept until evicted
+
+/*
+  Glyphs are referenced by id, the driver keeps them in CGRAM slots and evicts the least
+  recently used slot when a missing glyph has to be loaded. Slots whose code is on the screen
+  and animated slots are never evicted, slots holding identical bitmap are shared between ids.
+*/
+typedef struct lcd_glyph_table
+{
+    u8 bitmaps[LCD_GLYPH_COUNT][8];
+    DECLARE_BITMAP(registered, LCD_GLYPH_COUNT);
+    u64 slot_used[LCD_GLYPH_SLOTS];     //LRU stamps of CGRAM slots
+    u64 clock;
+} LcdGlyphTable_t;
+
+typedef struct LcdGlyphArgs_t {
+    u8 id;                      //glyph id, set by driver with LCD_GLYPH_AUTO
+    u8 flags;
+    u8 reserved[2];
+    u8 bitmap[8];
+} LcdGlyphArgs_t;
+
+struct LcdDescriptor_t;
+
+int lcdglyph_register(LcdGlyphTable_t *table, int id, const u8 *bitmap);
+void lcdglyph_remove(LcdGlyphTable_t *table, u8 id);
+bool lcdglyph_registered(LcdGlyphTable_t *table, u8 id);
+uint lcdglyph_distinct(LcdGlyphTable_t *table, const u8 *ids, uint count);
+int lcdglyph_mapbitmaps(struct LcdDescriptor_t *lcd, const u8 *const *bitmaps, uint count, u8 *codes);
+int lcdglyph_map(struct LcdDescriptor_t *lcd, const u8 *ids, uint count, u8 *codes);
+
+#endif //LCDI2C_LCDGLYPH_H
@@ -6,6 +6,9 @@
 
 #include "lcdi2c_main.h"
 
+#define CREATE_TRACE_POINTS
+#include "lcdi2c_trace.h"
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jarek Zok <jarekzok@gmail.com>");
 MODULE_DESCRIPTION(LCDI2C_DESCRIPTION);
@@ -18,8 +21,17 @@ static uint cursor = 0;
 static uint blink = 0;
 static uint swscreen = 0;
 static uint pinout_cnt = 0;
+static uint writeback = 0;
+static uint framerate = LCD_DEFAULT_FRAMERATE;
+static uint busyflag = 0;
+static uint streamsize = 0;
 static char *wscreen = DEFAULT_WS;
-static LcdDescriptor_t *lcdi2c_gDescriptor;
+static char *charset = "raw";
+static uint terminal = 0;
+static struct class *lcdi2c_class;
+static dev_t lcdi2c_devt;
+static DEFINE_IDA(lcdi2c_minors);
+static struct dentry *lcdi2c_debugfs;
 
 module_param(bus, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 module_param(address, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
@@ -29,6 +41,12 @@ module_param(blink, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 module_param(topo, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 module_param(swscreen, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 module_param(wscreen, charp, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+module_param(writeback, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+module_param(framerate, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+module_param(busyflag, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+module_param(streamsize, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+module_param(charset, charp, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+module_param(terminal, uint, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 
 MODULE_PARM_DESC(pinout, " I2C module pinout configuration, eight "
                          "numbers\n\t\trepresenting following LCD module"
@@ -48,6 +66,17 @@ MODULE_PARM_DESC(topo, " Display organization, following values are supported:\n
                        "\t\tDefault set to 4 (16x2)");
 MODULE_PARM_DESC(swscreen, " Show welcome screen on load, 1 - Yes, 0 - No, default 0");
 MODULE_PARM_DESC(wscreen, " Welcome screen string, default \""DEFAULT_WS"\"");
+MODULE_PARM_DESC(writeback, " Write-back mode, buffer updates return immediately and are flushed\n"
+                            "\t\tto LCD in background, 1 - Yes, 0 - No, default 0");
+MODULE_PARM_DESC(framerate, " Maximum number of write-back flushes per second, default 20");
+MODULE_PARM_DESC(busyflag, " Poll LCD busy flag instead of waiting fixed times, requires RW line\n"
+                           "\t\tconnected to the expander, 1 - Yes, 0 - No, default 0");
+MODULE_PARM_DESC(streamsize, " Stream mode ring size in bytes, write() appends text to the ring which is\n"
+                             "\t\tprinted on LCD in background, 0 - stream mode off, default 0");
+MODULE_PARM_DESC(charset, " Character set of text written to the device, raw - bytes are character codes,\n"
+                          "\t\ta00 - UTF-8 for Japanese ROM, a02 - UTF-8 for European ROM, default raw");
+MODULE_PARM_DESC(terminal, " Terminal mode, text written to the device is interpreted as a VT100 subset\n"
+                           "\t\twith cursor addressing, erasing and scrolling, 1 - Yes, 0 - No, default 0");
 
 static const IOCTLDescription_t ioControls[] = {
         {.ioctl_code = LCD_IOCTL_GETCHAR, .name = "GETCHAR",},
@@ -71,6 +100,16 @@ static const IOCTLDescription_t ioControls[] = {
         {.ioctl_code = LCD_IOCTL_GETCUSTOMCHAR, .name = "GETCUSTOMCHAR"},
         {.ioctl_code = LCD_IOCTL_SETCUSTOMCHAR, .name = "SETCUSTOMCHAR"},
         {.ioctl_code = LCD_IOCTL_CLEAR, .name = "CLEAR"},
+        {.ioctl_code = LCD_IOCTL_SYNC, .name = "SYNC"},
+        {.ioctl_code = LCD_IOCTL_COMMIT, .name = "COMMIT"},
+        {.ioctl_code = LCD_IOCTL_BATCH, .name = "BATCH"},
+        {.ioctl_code = LCD_IOCTL_GETSTATE, .name = "GETSTATE"},
+        {.ioctl_code = LCD_IOCTL_SETGLYPH, .name = "SETGLYPH"},
+        {.ioctl_code = LCD_IOCTL_ANIMATE, .name = "ANIMATE"},
+        {.ioctl_code = LCD_IOCTL_MARQUEE, .name = "MARQUEE"},
+        {.ioctl_code = LCD_IOCTL_SETPAGE, .name = "SETPAGE"},
+        {.ioctl_code = LCD_IOCTL_FLIP, .name = "FLIP"},
+        {.ioctl_code = LCD_IOCTL_SETWINDOW, .name = "SETWINDOW"},
 
 };
 
@@ -103,12 +142,15 @@ static struct i2c_driver lcdi2c_driver = {
 };
 
 static struct file_operations lcdi2c_fops = {
-        .read = lcdi2c_fopread,
-        .write = lcdi2c_fopwrite,
-        .llseek = lcdi2c_lseek,
-        .unlocked_ioctl = lcdi2c_ioctl,
-        .open = lcdi2c_open,
-        .release = lcdi2c_release,
+        .read = lcdi2c_traced_read,
+        .write = lcdi2c_traced_write,
+        .llseek = lcdi2c_traced_lseek,
+        .unlocked_ioctl = lcdi2c_traced_ioctl,
+        .open = lcdi2c_traced_open,
+        .release = lcdi2c_traced_release,
+        .fsync = lcdi2c_traced_fsync,
+        .mmap = lcdi2c_traced_mmap,
+        .poll = lcdi2c_traced_poll,
         .owner = THIS_MODULE,
 };
 
@@ -125,59 +167,598 @@ static int lcdi2c_dev_uevent(struct device *_, struct kobj_uevent_env *env) {
     return 0;
 }
 
+/*
+ * Semaphore wait of an operation, time spent waiting goes to lock wait
+ * histogram and to the trace
+ */
+static int lcdi2c_sem_down(LcdDescriptor_t *lcd_handler) {
+    const ktime_t start = ktime_get();
+    s64 wait_ns;
+    int ret;
+
+    ret = down_interruptible(&lcd_handler->driver_data.sem);
+    wait_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+    lcdstats_record(&lcd_handler->stats.lock_wait, wait_ns);
+    trace_lcdi2c_sem_wait(lcd_handler, wait_ns, ret);
+    //removed device is left alone, whoever waited for it gets nothing
+    if (!ret && lcd_handler->driver_data.gone) {
+        up(&lcd_handler->driver_data.sem);
+        ret = -ENODEV;
+    }
+    return ret;
+}
+
 static void set_welcome_message(LcdDescriptor_t *lcdData, char *welcome_msg) {
     strncpy(lcdData->welcome, strlen(welcome_msg) ? welcome_msg : DEFAULT_WS, WS_MAX_LEN);
 }
 
+/*
+ * Write-back worker, sends everything changed in raw_data since the last frame,
+ * then the back page if there's a new one
+ */
+static void lcdi2c_flush_work(struct work_struct *work) {
+    LcdDescriptor_t *lcd_handler = container_of(to_delayed_work(work), LcdDescriptor_t, driver_data.flush_work);
+
+    down(&lcd_handler->driver_data.sem);
+    lcdflushbuffer(lcd_handler);
+    lcdflushpage(lcd_handler);
+    lcd_handler->driver_data.last_flush = ktime_get();
+    SEM_UP(lcd_handler);
+}
+
+/*
+ * Stream mode consumer, prints the ring content in order. Space is given back
+ * to writers before the bus is touched.
+ */
+static void lcdi2c_stream_work(struct work_struct *work) {
+    LcdDescriptor_t *lcd_handler = container_of(work, LcdDescriptor_t, driver_data.stream_work);
+    Lcdi2cDriver_t *drv = &lcd_handler->driver_data;
+    char chunk[LCD_BUFFER_SIZE];
+    uint len;
+
+    while ((len = kfifo_out(&drv->stream, chunk, sizeof(chunk)))) {
+        wake_up_interruptible(&drv->stream_wq);
+        down(&drv->sem);
+        if (lcd_handler->term.enabled) {
+            lcdterm_write(lcd_handler, (const u8 *) chunk, len);
+            lcdflushbuffer(lcd_handler);
+        } else {
+            lcdprintn(lcd_handler, chunk, len);
+        }
+        lcdsetcursor(lcd_handler, lcd_handler->column, lcd_handler->row);
+        SEM_UP(lcd_handler);
+    }
+}
+
+/*
+ * Stream mode write, appends whole data to the ring. Writer sleeps only while
+ * the ring is full, O_NONBLOCK writer gets what fitted or EAGAIN then.
+ */
+static ssize_t lcdi2c_stream_write(LcdDescriptor_t *lcd_handler, struct file *file,
+                                   const char __user *buffer, size_t length) {
+    Lcdi2cDriver_t *drv = &lcd_handler->driver_data;
+    const bool nonblock = file->f_flags & O_NONBLOCK;
+    size_t written = 0;
+    uint copied;
+    ssize_t ret = 0;
+
+    if (nonblock ? !mutex_trylock(&drv->stream_mutex) : mutex_lock_interruptible(&drv->stream_mutex))
+        return nonblock ? -EAGAIN : -ERESTARTSYS;
+
+    while (written < length) {
+        if (kfifo_is_full(&drv->stream)) {
+            if (nonblock) {
+                ret = -EAGAIN;
+                break;
+            }
+            ret = wait_event_interruptible(drv->stream_wq, !kfifo_is_full(&drv->stream) || drv->gone);
+            if (ret)
+                break;
+        }
+        //remove waits for the mutex before the workqueue goes away
+        if (drv->gone) {
+            ret = -ENODEV;
+            break;
+        }
+        if (kfifo_from_user(&drv->stream, buffer + written, length - written, &copied)) {
+            ret = -EFAULT;
+            break;
+        }
+        written += copied;
+        queue_work(drv->wq, &drv->stream_work);
+    }
+    mutex_unlock(&drv->stream_mutex);
+
+    return written ? written : ret;
+}
+
+/*
+ * Effects worker, runs every effect step which is due and arms the timer
+ * for the next one. Nothing is armed once all effects are over. The timer is
+ * armed under the semaphore, so lcdi2c_effects_cancel finds it armed once it
+ * has stopped the effects, or the step sees them stopped and arms nothing.
+ */
+static void lcdi2c_effects_work(struct work_struct *work) {
+    LcdDescriptor_t *lcd_handler = container_of(work, LcdDescriptor_t, driver_data.effects_work);
+    ktime_t next;
+
+    down(&lcd_handler->driver_data.sem);
+    next = lcdeffects_step(lcd_handler, ktime_get());
+    if (next != KTIME_MAX)
+        hrtimer_start_range_ns(&lcd_handler->driver_data.effects_timer, next,
+                               LCD_EFFECTS_SLACK_NS, HRTIMER_MODE_ABS);
+    SEM_UP(lcd_handler);
+}
+
+/*
+ * Timer runs in interrupt context, the bus is talked to from the worker
+ */
+static enum hrtimer_restart lcdi2c_effects_timer(struct hrtimer *timer) {
+    LcdDescriptor_t *lcd_handler = container_of(timer, LcdDescriptor_t, driver_data.effects_timer);
+
+    queue_work(lcd_handler->driver_data.wq, &lcd_handler->driver_data.effects_work);
+    return HRTIMER_NORESTART;
+}
+
+/*
+ * Stops all effects and waits until the timer and the worker are idle. Timer
+ * which fired meanwhile may queue the worker once more, it finds nothing to do.
+ */
+static void lcdi2c_effects_cancel(LcdDescriptor_t *lcd_handler) {
+    down(&lcd_handler->driver_data.sem);
+    lcdeffects_stop(lcd_handler);
+    up(&lcd_handler->driver_data.sem);
+
+    hrtimer_cancel(&lcd_handler->driver_data.effects_timer);
+    cancel_work_sync(&lcd_handler->driver_data.effects_work);
+}
+
+/*
+ * Sends raw_data to LCD, caller has to hold the semaphore. In write-back mode
+ * the flush is only scheduled, no sooner than one frame period after
+ * the previous one. Updates made before it runs are coalesced into that frame.
+ */
+static void lcdi2c_flush(LcdDescriptor_t *lcd_handler) {
+    Lcdi2cDriver_t *drv = &lcd_handler->driver_data;
+    ktime_t next;
+    s64 wait_ns;
+
+    if (!drv->writeback) {
+        lcdflushbuffer(lcd_handler);
+        return;
+    }
+
+    next = ktime_add_ns(drv->last_flush, NSEC_PER_SEC / drv->framerate);
+    wait_ns = ktime_to_ns(ktime_sub(next, ktime_get()));
+    //frame period is over already, flush pending with a longer delay runs right away
+    if (wait_ns > 0)
+        queue_delayed_work(drv->wq, &drv->flush_work, nsecs_to_jiffies(wait_ns));
+    else
+        mod_delayed_work(drv->wq, &drv->flush_work, 0);
+}
+
+/*
+ * Copies damaged part of the mmap()ed framebuffer and custom characters changed since
+ * the last commit into driver state and flushes it to LCD. Caller has to hold the semaphore.
+ */
+static void lcdi2c_commit(LcdDescriptor_t *lcd_handler, LcdCommitArgs_t *damage) {
+    const u8 columns = lcd_handler->organization.columns, rows = lcd_handler->organization.rows;
+    LcdFramebuffer_t *fb = lcd_handler->fb;
+    u8 col = 0, row = 0, width = columns, height = rows;
+    u8 load = 0, first;
+
+    if (damage && damage->columns && damage->rows) {
+        col = min(damage->column, columns);
+        row = min(damage->row, rows);
+        width = min_t(u8, damage->columns, columns - col);
+        height = min_t(u8, damage->rows, rows - row);
+    }
+
+    for (u8 r = row; r < row + height; r++)
+        memcpy(lcd_handler->raw_data + r * columns + col, fb->cells + r * columns + col, width);
+
+    //slots untouched in the page may hold paged glyphs or animations by now, leave them be,
+    //changed ones are uploaded from the copy as application may be writing the page meanwhile
+    for (u8 s = 0; s < 8; s++) {
+        if ((lcd_handler->effects.animated & (1 << s)) ||
+            !memcmp(fb->custom_chars[s], lcd_handler->fb_committed[s], sizeof(CustomChar_t)))
+            continue;
+        memcpy(lcd_handler->fb_committed[s], fb->custom_chars[s], sizeof(CustomChar_t));
+        load |= 1 << s;
+    }
+    for (u8 s = 0; s < 8; s++) {
+        if (!(load & (1 << s)))
+            continue;
+        for (first = s; s + 1 < 8 && (load & (1 << (s + 1))); s++);
+        lcdcustomchars(lcd_handler, first, s - first + 1, lcd_handler->fb_committed + first);
+    }
+    lcdi2c_flush(lcd_handler);
+}
+
+/*
+ * Checks a single BATCH operation against current display geometry
+ */
+static int lcdi2c_batch_check(LcdDescriptor_t *lcd_handler, const LcdBatchOp_t *op) {
+    const u8 columns = lcd_handler->organization.columns, rows = lcd_handler->organization.rows;
+
+    switch (op->op) {
+        case LCD_BATCH_POSITION:
+            return (op->column < columns && op->row < rows) ? 0 : -EINVAL;
+        case LCD_BATCH_TEXT:
+            return (op->column < columns && op->row < rows && op->value <= sizeof(op->data) &&
+                    op->value <= columns * rows - (op->row * columns + op->column)) ? 0 : -EINVAL;
+        case LCD_BATCH_LINE:
+            return op->row < rows ? 0 : -EINVAL;
+        case LCD_BATCH_CUSTOMCHAR:
+            return op->value < 8 ? 0 : -EINVAL;
+        case LCD_BATCH_GLYPHS:
+            if (op->column >= columns || op->row >= rows || op->value > sizeof(op->data) ||
+                op->value > columns * rows - (op->row * columns + op->column))
+                return -EINVAL;
+            for (u8 i = 0; i < op->value; i++) {
+                if (!lcdglyph_registered(&lcd_handler->glyphs, op->data[i]))
+                    return -ENOENT;
+            }
+            return lcdglyph_distinct(&lcd_handler->glyphs, op->data, op->value) <= LCD_GLYPH_SLOTS ? 0 : -ENOSPC;
+        case LCD_BATCH_BACKLIGHT:
+        case LCD_BATCH_CURSOR:
+        case LCD_BATCH_BLINK:
+        case LCD_BATCH_CLEAR:
+            return 0;
+        default:
+            return -EINVAL;
+    }
+}
+
+/*
+ * Executes BATCH operations. Text lands in raw_data and goes to LCD with a single
+ * flush at the end, everything else is queued into the same bus frame.
+ * Caller has to hold the semaphore and operations have to be checked already.
+ */
+static void lcdi2c_batch_run(LcdDescriptor_t *lcd_handler, LcdBatchOp_t *ops, u32 count) {
+    const u8 columns = lcd_handler->organization.columns, rows = lcd_handler->organization.rows;
+    u8 column = lcd_handler->column, row = lcd_handler->row;
+    u8 codes[LCD_MAX_LINE_LENGTH];
+    const u8 *text;
+    u16 offset;
+    int status;
+
+    lcdbegin(lcd_handler);
+    for (u32 i = 0; i < count; i++) {
+        LcdBatchOp_t *op = ops + i;
+
+        status = 0;
+        switch (op->op) {
+            case LCD_BATCH_POSITION:
+                column = op->column;
+                row = op->row;
+                break;
+            case LCD_BATCH_GLYPHS:
+            case LCD_BATCH_TEXT:
+                text = op->data;
+                if (op->op == LCD_BATCH_GLYPHS) {
+                    //all slots may be on the screen by now, then the op fails alone
+                    status = lcdglyph_map(lcd_handler, op->data, op->value, codes);
+                    if (status)
+                        break;
+                    text = codes;
+                }
+                offset = op->row * columns + op->column;
+                memcpy(lcd_handler->raw_data + offset, text, op->value);
+                offset = (offset + op->value) % (columns * rows);
+                column = offset % columns;
+                row = offset / columns;
+                break;
+            case LCD_BATCH_LINE:
+                memcpy(lcd_handler->raw_data + op->row * columns, op->data, columns);
+                break;
+            case LCD_BATCH_CUSTOMCHAR:
+                lcdcustomchar(lcd_handler, op->value, op->data);
+                break;
+            case LCD_BATCH_BACKLIGHT:
+                lcdsetbacklight(lcd_handler, op->value);
+                break;
+            case LCD_BATCH_CURSOR:
+                lcd_handler->cursor = op->value ? 1 : 0;
+                lcdcursor(lcd_handler, lcd_handler->cursor);
+                break;
+            case LCD_BATCH_BLINK:
+                lcd_handler->blink = op->value ? 1 : 0;
+                lcdblink(lcd_handler, lcd_handler->blink);
+                break;
+            case LCD_BATCH_CLEAR:
+                lcdclear(lcd_handler);
+                column = 0;
+                row = 0;
+                break;
+        }
+        op->status = status;
+    }
+
+    lcd_handler->column = column;
+    lcd_handler->row = row;
+    lcdi2c_flush(lcd_handler);
+    lcdsetcursor(lcd_handler, column, row);
+    lcdend(lcd_handler);
+}
+
+/*
+ * SETGLYPH ioctl, registers or removes a glyph of the virtual glyph table.
+ * Id picked by the driver is returned to the caller.
+ */
+static long lcdi2c_glyph(LcdDescriptor_t *lcd_handler, void __user *arg) {
+    LcdGlyphArgs_t glyph;
+    long status = SUCCESS;
+
+    if (copy_from_user(&glyph, arg, sizeof(LcdGlyphArgs_t)))
+        return -EIO;
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -EBUSY;
+    }
+    if (glyph.flags & LCD_GLYPH_REMOVE) {
+        lcdglyph_remove(&lcd_handler->glyphs, glyph.id);
+    } else {
+        status = lcdglyph_register(&lcd_handler->glyphs, (glyph.flags & LCD_GLYPH_AUTO) ? -1 : glyph.id,
+                                   glyph.bitmap);
+        if (status >= 0) {
+            glyph.id = status;
+            status = SUCCESS;
+        }
+    }
+    SEM_UP(lcd_handler);
+
+    if (status)
+        return status;
+    if (copy_to_user(arg, &glyph, sizeof(LcdGlyphArgs_t)))
+        return -EIO;
+
+    return SUCCESS;
+}
+
+/*
+ * MARQUEE ioctl, starts or stops marquee of a row. Text is copied before
+ * the semaphore is taken, marquee keeps it until it's stopped.
+ */
+static long lcdi2c_marquee(LcdDescriptor_t *lcd_handler, void __user *arg) {
+    LcdMarqueeArgs_t args;
+    u8 *text = NULL;
+    long status;
+
+    if (copy_from_user(&args, arg, sizeof(LcdMarqueeArgs_t)))
+        return -EIO;
+    if (args.length > LCD_MARQUEE_MAX_TEXT)
+        return -EINVAL;
+
+    if (args.length) {
+        text = kmalloc(args.length, GFP_KERNEL);
+        if (!text)
+            return -ENOMEM;
+        if (copy_from_user(text, u64_to_user_ptr(args.text), args.length)) {
+            kfree(text);
+            return -EIO;
+        }
+    }
+
+    if (SEM_DOWN(lcd_handler)) {
+        kfree(text);
+        return -EBUSY;
+    }
+    status = lcdeffects_marquee(lcd_handler, &args, text);
+    if (status == SUCCESS)
+        queue_work(lcd_handler->driver_data.wq, &lcd_handler->driver_data.effects_work);
+    else
+        kfree(text);
+    SEM_UP(lcd_handler);
+
+    return status;
+}
+
+/*
+ * BATCH ioctl, operations are copied and checked before the semaphore is taken,
+ * if any of them is invalid nothing is executed. Status of every operation
+ * and final cursor position are returned to the caller.
+ */
+static long lcdi2c_batch(LcdDescriptor_t *lcd_handler, void __user *arg) {
+    LcdBatchArgs_t args;
+    LcdBatchOp_t *ops, __user *user_ops;
+    long status = SUCCESS;
+
+    if (copy_from_user(&args, arg, sizeof(LcdBatchArgs_t)))
+        return -EFAULT;
+    if (!args.count || args.count > LCD_BATCH_MAX_OPS)
+        return -EINVAL;
+
+    user_ops = u64_to_user_ptr(args.ops);
+    ops = kmalloc_array(args.count, sizeof(LcdBatchOp_t), GFP_KERNEL);
+    if (!ops)
+        return -ENOMEM;
+    if (copy_from_user(ops, user_ops, args.count * sizeof(LcdBatchOp_t))) {
+        kfree(ops);
+        return -EFAULT;
+    }
+
+    if (SEM_DOWN(lcd_handler)) {
+        kfree(ops);
+        return -EBUSY;
+    }
+
+    for (u32 i = 0; i < args.count; i++) {
+        ops[i].status = lcdi2c_batch_check(lcd_handler, ops + i);
+        if (ops[i].status)
+            status = -EINVAL;
+    }
+    if (status == SUCCESS)
+        lcdi2c_batch_run(lcd_handler, ops, args.count);
+
+    args.column = lcd_handler->column;
+    args.row = lcd_handler->row;
+    SEM_UP(lcd_handler);
+
+    for (u32 i = 0; i < args.count; i++) {
+        if (put_user(ops[i].status, &user_ops[i].status))
+            status = -EFAULT;
+    }
+    if (copy_to_user(arg, &args, sizeof(LcdBatchArgs_t)))
+        status = -EFAULT;
+
+    kfree(ops);
+    return status;
+}
+
+/*
+ * Barrier for write-back and stream modes, returns once pending updates are on the LCD.
+ * Must be called without the semaphore held.
+ */
+static void lcdi2c_sync(LcdDescriptor_t *lcd_handler) {
+    if (kfifo_initialized(&lcd_handler->driver_data.stream))
+        flush_work(&lcd_handler->driver_data.stream_work);
+    flush_delayed_work(&lcd_handler->driver_data.flush_work);
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
 static int lcdi2c_probe(struct i2c_client *client) {
 #else
 static int lcdi2c_probe(struct i2c_client *client, const struct i2c_device_id *id) {
 #endif
-    int ret = 0;
-
-    lcdi2c_gDescriptor = (LcdDescriptor_t *) devm_kzalloc(&client->dev, sizeof(LcdDescriptor_t), GFP_KERNEL);
-
-    if (!lcdi2c_gDescriptor)
-        return -ENOMEM;
+    LcdDescriptor_t *lcd_handler;
+    u32 topology = topo, prio, stream = streamsize;
+    const char *charset_name = charset;
+    int ret = 0, mode;
 
     if (device_property_present(&client->dev, "topology")) {
-        if (device_property_read_u32(&client->dev, "topology", &topo)) {
+        if (device_property_read_u32(&client->dev, "topology", &topology)) {
             dev_err(&client->dev, "topology property read failed\n");
             return -EINVAL;
         }
     }
 
-    sema_init(&lcdi2c_gDescriptor->driver_data.sem, 1);
-    lcdi2c_gDescriptor->driver_data.client = client;
-    lcdi2c_gDescriptor->driver_data.use_cnt = 0;
-    lcdi2c_gDescriptor->driver_data.open_cnt = 0;
-    lcdi2c_gDescriptor->backlight = 1;
-    lcdi2c_gDescriptor->cursor = cursor;
-    lcdi2c_gDescriptor->blink = blink;
-    lcdi2c_gDescriptor->show_welcome_screen = swscreen;
-    set_welcome_message(lcdi2c_gDescriptor, wscreen);
-    i2c_set_clientdata(client, lcdi2c_gDescriptor);
+    //open files can outlive the device, descriptor is freed when the last of them is released
+    lcd_handler = (LcdDescriptor_t *) kzalloc(sizeof(LcdDescriptor_t), GFP_KERNEL);
 
-    ret = lcdi2c_register(client);
-    if (0 != ret) {
-        kfree(lcdi2c_gDescriptor);
-        return ret;
+    if (!lcd_handler)
+        return -ENOMEM;
+    kref_init(&lcd_handler->driver_data.ref);
+
+    sema_init(&lcd_handler->driver_data.sem, 1);
+    lcdstats_init(&lcd_handler->stats);
+    lcd_handler->driver_data.client = client;
+    lcd_handler->driver_data.use_cnt = 0;
+    lcd_handler->driver_data.open_cnt = 0;
+    lcd_handler->backlight = 1;
+    lcd_handler->cursor = cursor;
+    lcd_handler->blink = blink;
+    lcd_handler->show_welcome_screen = swscreen;
+    lcd_handler->busy_flag = busyflag || device_property_present(&client->dev, "busy-flag");
+    device_property_read_u32(&client->dev, "exec-time-ns", &lcd_handler->timing.exec_ns);
+    device_property_read_u32(&client->dev, "clear-time-ns", &lcd_handler->timing.clear_ns);
+    if ((lcd_handler->timing.exec_ns && lcd_handler->timing.exec_ns < LCD_EXEC_MIN_NS) ||
+        (lcd_handler->timing.clear_ns && lcd_handler->timing.clear_ns < LCD_CLEAR_MIN_NS))
+        dev_warn(&client->dev, "timing below %ldns/%ldns, default used instead\n", LCD_EXEC_MIN_NS, LCD_CLEAR_MIN_NS);
+    lcd_handler->driver_data.writeback = writeback ? 1 : 0;
+    lcd_handler->driver_data.framerate = clamp_t(u32, framerate, 1, LCD_MAX_FRAMERATE);
+    lcd_handler->sched.priority = LCD_SCHED_DEFAULT_PRIORITY;
+    if (!device_property_read_u32(&client->dev, "priority", &prio))
+        lcd_handler->sched.priority = min_t(u32, prio, LCD_SCHED_MAX_PRIORITY);
+    device_property_read_u32(&client->dev, "stream-size", &stream);
+    device_property_read_string(&client->dev, "charset", &charset_name);
+    mode = lcdcharset_parse(charset_name);
+    if (mode < 0) {
+        dev_err(&client->dev, "unknown charset %s, raw is used\n", charset_name);
+        mode = LCD_CHARSET_RAW;
+    }
+    lcdcharset_set(&lcd_handler->charset, mode);
+    lcd_handler->term.enabled = terminal || device_property_present(&client->dev, "terminal");
+    set_welcome_message(lcd_handler, wscreen);
+    i2c_set_clientdata(client, lcd_handler);
+
+    lcd_handler->fb = (LcdFramebuffer_t *) get_zeroed_page(GFP_KERNEL);
+    if (!lcd_handler->fb) {
+        kfree(lcd_handler);
+        return -ENOMEM;
+    }
+    atomic_set(&lcd_handler->fb_maps, 0);
+    seqlock_init(&lcd_handler->view_lock);
+    init_waitqueue_head(&lcd_handler->change_wq);
+
+    mutex_init(&lcd_handler->driver_data.stream_mutex);
+    init_waitqueue_head(&lcd_handler->driver_data.stream_wq);
+    INIT_WORK(&lcd_handler->driver_data.stream_work, lcdi2c_stream_work);
+    if (stream) {
+        ret = kfifo_alloc(&lcd_handler->driver_data.stream,
+                          clamp_t(u32, stream, LCD_STREAM_MIN_SIZE, LCD_STREAM_MAX_SIZE), GFP_KERNEL);
+        if (ret)
+            goto streamError;
+    }
+
+    INIT_DELAYED_WORK(&lcd_handler->driver_data.flush_work, lcdi2c_flush_work);
+    INIT_WORK(&lcd_handler->driver_data.effects_work, lcdi2c_effects_work);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+    hrtimer_setup(&lcd_handler->driver_data.effects_timer, lcdi2c_effects_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+#else
+    hrtimer_init(&lcd_handler->driver_data.effects_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+    lcd_handler->driver_data.effects_timer.function = lcdi2c_effects_timer;
+#endif
+    lcd_handler->driver_data.wq = alloc_ordered_workqueue("lcdi2c-%d-%02x", 0,
+                                                          client->adapter->nr, client->addr);
+    if (!lcd_handler->driver_data.wq) {
+        ret = -ENOMEM;
+        goto wqError;
+    }
+
+    ret = lcdsched_attach(&lcd_handler->sched, client->adapter);
+    if (ret)
+        goto schedError;
+
+    /*
+     * LCD has to be initialized before the device node appears, otherwise
+     * an early open could talk to the controller in the middle of lcdinit
+     */
+    lcdinit(lcd_handler, topology);
+    if (lcd_handler->show_welcome_screen) {
+        lcdprint(lcd_handler, lcd_handler->welcome);
     }
+    lcdpublish(lcd_handler);
 
-    lcdinit(lcdi2c_gDescriptor, topo);
-    if (lcdi2c_gDescriptor->show_welcome_screen) {
-        lcdprint(lcdi2c_gDescriptor, lcdi2c_gDescriptor->welcome);
+    ret = lcdi2c_register(client);
+    if (0 != ret) {
+        lcdfinalize(lcd_handler);
+        lcdsched_detach(&lcd_handler->sched);
+        goto schedError;
     }
 
     dev_info(&client->dev, "Registered LCD display with %u-columns x %u-rows on bus 0x%X at address 0x%X",
-             lcdi2c_gDescriptor->organization.columns,
-             lcdi2c_gDescriptor->organization.rows, client->adapter->nr, client->addr);
+             lcd_handler->organization.columns,
+             lcd_handler->organization.rows, client->adapter->nr, client->addr);
     return 0;
+
+schedError:
+    destroy_workqueue(lcd_handler->driver_data.wq);
+wqError:
+    kfifo_free(&lcd_handler->driver_data.stream);
+streamError:
+    free_page((unsigned long) lcd_handler->fb);
+    kfree(lcd_handler);
+    return ret;
+}
+
+/*
+ * Last reference to the descriptor is gone, the device was removed and
+ * no file has it open anymore
+ */
+static void lcdi2c_free(struct kref *ref) {
+    LcdDescriptor_t *lcd_handler = container_of(ref, LcdDescriptor_t, driver_data.ref);
+
+    kfifo_free(&lcd_handler->driver_data.stream);
+    free_page((unsigned long) lcd_handler->fb);
+    kfree(lcd_handler);
 }
 
 static void lcdi2c_shutdown(struct i2c_client *client) {
     LcdDescriptor_t *lcd_handler = i2c_get_clientdata(client);
+    lcdi2c_effects_cancel(lcd_handler);
+    cancel_work_sync(&lcd_handler->driver_data.stream_work);
+    cancel_delayed_work_sync(&lcd_handler->driver_data.flush_work);
     lcdfinalize(lcd_handler);
 }
 
@@ -185,372 +766,889 @@ static void lcdi2c_remove(struct i2c_client *client) {
     LcdDescriptor_t *lcd_handler = i2c_get_clientdata(client);
 
     dev_info(&client->dev, "going to be removed");
-    lcdfinalize(lcd_handler);
     lcdi2c_unregister(client);
+
+    //files still open get ENODEV from now on, none of them gets to the bus or the workqueue
+    down(&lcd_handler->driver_data.sem);
+    lcd_handler->driver_data.gone = 1;
+    up(&lcd_handler->driver_data.sem);
+    wake_up_interruptible(&lcd_handler->driver_data.stream_wq);
+    wake_up_interruptible(&lcd_handler->change_wq);
+    mutex_lock(&lcd_handler->driver_data.stream_mutex);
+    mutex_unlock(&lcd_handler->driver_data.stream_mutex);
+
+    lcdi2c_effects_cancel(lcd_handler);
+    cancel_work_sync(&lcd_handler->driver_data.stream_work);
+    cancel_delayed_work_sync(&lcd_handler->driver_data.flush_work);
+    destroy_workqueue(lcd_handler->driver_data.wq);
+    lcdfinalize(lcd_handler);
+    lcdsched_detach(&lcd_handler->sched);
+    kref_put(&lcd_handler->driver_data.ref, lcdi2c_free);
 }
 
+/*
+ * Creates /dev/lcdi2c-<bus>-<address> and its sysfs directory, using one
+ * minor number from the range reserved by the module
+ */
 static int lcdi2c_register(struct i2c_client *client) {
     LcdDescriptor_t *lcd_handler = i2c_get_clientdata(client);
+    dev_t devt;
+    int ret;
 
-    if (alloc_chrdev_region(&lcd_handler->driver_data.major, 0, 1, DEVICE_NAME) < 0) {
-        dev_err(&client->dev, "failed to allocate major number\n");
-        return -1;
+    ret = ida_alloc_max(&lcdi2c_minors, LCDI2C_MAX_DEVICES - 1, GFP_KERNEL);
+    if (ret < 0) {
+        dev_err(&client->dev, "no free minor number, at most %d displays are supported\n", LCDI2C_MAX_DEVICES);
+        return ret;
     }
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
-    lcd_handler->driver_data.lcdi2c_class = class_create(DEVICE_CLASS_NAME);
-#else
-    lcd_handler->driver_data.lcdi2c_class = class_create(THIS_MODULE, DEVICE_CLASS_NAME);
-#endif
-    if (IS_ERR(lcd_handler->driver_data.lcdi2c_class)) {
-        dev_warn(&client->dev, "class creation failed %s\n", DEVICE_CLASS_NAME);
-        goto classError;
-    }
+    lcd_handler->driver_data.major = MAJOR(lcdi2c_devt);
+    lcd_handler->driver_data.minor = ret;
+    lcd_handler->driver_data.lcdi2c_class = lcdi2c_class;
+    devt = MKDEV(lcd_handler->driver_data.major, lcd_handler->driver_data.minor);
+
+    cdev_init(&lcd_handler->driver_data.cdev, &lcdi2c_fops);
+    lcd_handler->driver_data.cdev.owner = THIS_MODULE;
 
-    lcd_handler->driver_data.minor = lcd_handler->driver_data.major & MINORMASK;
+    ret = cdev_add(&lcd_handler->driver_data.cdev, devt, 1);
+    if (ret < 0) {
+        dev_err(&client->dev, "cdev_add failed\n");
+        goto cdevError;
+    }
 
-    lcd_handler->driver_data.lcdi2c_class->dev_uevent = lcdi2c_dev_uevent;
-    lcd_handler->driver_data.lcdi2c_device = device_create(lcd_handler->driver_data.lcdi2c_class,
-                                                           NULL,
-                                                           lcd_handler->driver_data.major,
-                                                           NULL,
-                                                           DEVICE_NAME);
+    lcd_handler->driver_data.lcdi2c_device = device_create(lcdi2c_class, &client->dev, devt, lcd_handler,
+                                                           DEVICE_NAME "-%d-%02x",
+                                                           client->adapter->nr, client->addr);
     if (IS_ERR(lcd_handler->driver_data.lcdi2c_device)) {
-        dev_warn(&client->dev, "device %s creation failed\n", DEVICE_NAME);
+        dev_err(&client->dev, "device %s-%d-%02x creation failed\n", DEVICE_NAME,
+                client->adapter->nr, client->addr);
+        ret = PTR_ERR(lcd_handler->driver_data.lcdi2c_device);
         goto fileError;
     }
 
-    cdev_init(&lcd_handler->driver_data.cdev, &lcdi2c_fops);
-
-    if (cdev_add(&lcd_handler->driver_data.cdev, lcd_handler->driver_data.major, 1) < 0) {
-        dev_warn(&client->dev, "cdev_add failed\n");
-        goto addError;
+    ret = sysfs_create_group(&lcd_handler->driver_data.lcdi2c_device->kobj, &i2clcd_device_attr_group);
+    if (ret) {
+        dev_err(&client->dev, "device attribute group creation failed\n");
+        goto groupError;
     }
 
-    if (sysfs_create_group(&lcd_handler->driver_data.lcdi2c_device->kobj, &i2clcd_device_attr_group)) {
-        dev_warn(&client->dev, "device attribute group creation failed\n");
-        goto addError;
-    }
+    lcdi2c_debugfs_create(lcd_handler);
 
-    dev_info(&client->dev, "registered with Major: %u Minor: %u\n", lcd_handler->driver_data.major >> 20,
-             lcd_handler->driver_data.major & MINORMASK);
+    dev_info(&client->dev, "registered with Major: %u Minor: %u\n", lcd_handler->driver_data.major,
+             lcd_handler->driver_data.minor);
 
     return 0;
 
-addError:
-    device_destroy(lcd_handler->driver_data.lcdi2c_class, lcd_handler->driver_data.major);
+groupError:
+    device_destroy(lcdi2c_class, devt);
 fileError:
-    class_destroy(lcd_handler->driver_data.lcdi2c_class);
-classError:
-    unregister_chrdev_region(lcd_handler->driver_data.major, 1);
-    i2c_unregister_device(client);
-    i2c_del_driver(&lcdi2c_driver);
-    return -1;
+    cdev_del(&lcd_handler->driver_data.cdev);
+cdevError:
+    ida_free(&lcdi2c_minors, lcd_handler->driver_data.minor);
+    return ret;
 }
 
 
 static void lcdi2c_unregister(struct i2c_client *client) {
     LcdDescriptor_t *lcd_handler = i2c_get_clientdata(client);
+    dev_t devt = MKDEV(lcd_handler->driver_data.major, lcd_handler->driver_data.minor);
 
-    cdev_del(&lcd_handler->driver_data.cdev);
+    debugfs_remove_recursive(lcd_handler->driver_data.debugfs);
     sysfs_remove_group(&lcd_handler->driver_data.lcdi2c_device->kobj, &i2clcd_device_attr_group);
-    device_destroy(lcd_handler->driver_data.lcdi2c_class, lcd_handler->driver_data.major);
-    class_destroy(lcd_handler->driver_data.lcdi2c_class);
-    unregister_chrdev_region(lcd_handler->driver_data.major, 1);
+    device_destroy(lcdi2c_class, devt);
+    cdev_del(&lcd_handler->driver_data.cdev);
+    ida_free(&lcdi2c_minors, lcd_handler->driver_data.minor);
 }
 
 
-static int lcdi2c_open(struct inode *_, struct file *__) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -EBUSY;
+static int lcdi2c_open(struct inode *inode, struct file *file) {
+    LcdDescriptor_t *lcd_handler = container_of(inode->i_cdev, LcdDescriptor_t, driver_data.cdev);
+    LcdFile_t *lcd_file;
+    int ret;
+
+    lcd_file = kzalloc(sizeof(LcdFile_t), GFP_KERNEL);
+    if (!lcd_file)
+        return -ENOMEM;
+    lcd_file->lcd = lcd_handler;
+
+    ret = SEM_DOWN(lcd_handler);
+    if (ret) {
+        kfree(lcd_file);
+        return ret == -ENODEV ? ret : -EBUSY;
     }
 
-    lcdi2c_gDescriptor->driver_data.open_cnt++;
-    try_module_get(THIS_MODULE);
-    SEM_UP(lcdi2c_gDescriptor);
+    file->private_data = lcd_file;
+    lcd_handler->driver_data.open_cnt++;
+    kref_get(&lcd_handler->driver_data.ref);
+    SEM_UP(lcd_handler);
 
     return SUCCESS;
 }
 
-static int lcdi2c_release(struct inode *_, struct file *__) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -EBUSY;
+static int lcdi2c_release(struct inode *inode, struct file *file) {
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
+
+    down(&lcd_handler->driver_data.sem);
+    lcd_handler->driver_data.open_cnt--;
+    SEM_UP(lcd_handler);
+    kfree(file->private_data);
+    kref_put(&lcd_handler->driver_data.ref, lcdi2c_free);
+
+    return SUCCESS;
+}
+
+/*
+ * Readable whenever content was published since this file last read it,
+ * by read() or GETSTATE. New files see the current content as a change.
+ * Writable always, in stream mode while there's space in the ring.
+ */
+static __poll_t lcdi2c_poll(struct file *file, poll_table *wait) {
+    LcdFile_t *lcd_file = file->private_data;
+    LcdDescriptor_t *lcd_handler = lcd_file->lcd;
+    struct kfifo *stream = &lcd_handler->driver_data.stream;
+    __poll_t mask = 0;
+
+    poll_wait(file, &lcd_handler->change_wq, wait);
+    if (lcd_handler->driver_data.gone)
+        return EPOLLHUP | EPOLLERR;
+    if (lcdgeneration(lcd_handler) != lcd_file->generation)
+        mask |= EPOLLIN | EPOLLRDNORM;
+
+    if (kfifo_initialized(stream)) {
+        poll_wait(file, &lcd_handler->driver_data.stream_wq, wait);
+        if (!kfifo_is_full(stream))
+            mask |= EPOLLOUT | EPOLLWRNORM;
+    } else {
+        mask |= EPOLLOUT | EPOLLWRNORM;
+    }
+
+    return mask;
+}
+
+static int lcdi2c_fsync(struct file *file, loff_t start, loff_t end, int datasync) {
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
+    lcdi2c_sync(lcd_handler);
+    return SUCCESS;
+}
+
+/*
+ * remap_pfn_range() takes no page reference, so every mapping holds the descriptor
+ * instead, fb page is freed with it once the last mapping and file are gone
+ */
+static void lcdi2c_vm_open(struct vm_area_struct *vma) {
+    LcdDescriptor_t *lcd_handler = vma->vm_private_data;
+    atomic_inc(&lcd_handler->fb_maps);
+    kref_get(&lcd_handler->driver_data.ref);
+}
+
+static void lcdi2c_vm_close(struct vm_area_struct *vma) {
+    LcdDescriptor_t *lcd_handler = vma->vm_private_data;
+    atomic_dec(&lcd_handler->fb_maps);
+    kref_put(&lcd_handler->driver_data.ref, lcdi2c_free);
+}
+
+static const struct vm_operations_struct lcdi2c_vm_ops = {
+        .open = lcdi2c_vm_open,
+        .close = lcdi2c_vm_close,
+};
+
+/*
+ * Maps the framebuffer page. First mapping gets it filled with what's
+ * currently on the screen, later ones share whatever is being composed.
+ */
+static int lcdi2c_mmap(struct file *file, struct vm_area_struct *vma) {
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
+    LcdFramebuffer_t *fb = lcd_handler->fb;
+    int ret;
+
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start > PAGE_SIZE)
+        return -EINVAL;
+    //private mapping would get copy-on-write pages, COMMIT would never see what's written there
+    if (!(vma->vm_flags & VM_SHARED))
+        return -EINVAL;
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+    if (!atomic_read(&lcd_handler->fb_maps)) {
+        memcpy(fb->cells, lcd_handler->raw_data, LCD_BUFFER_SIZE);
+        memcpy(fb->custom_chars, lcd_handler->custom_chars, sizeof(fb->custom_chars));
+        memcpy(lcd_handler->fb_committed, fb->custom_chars, sizeof(lcd_handler->fb_committed));
     }
+    fb->columns = lcd_handler->organization.columns;
+    fb->rows = lcd_handler->organization.rows;
+    SEM_UP(lcd_handler);
 
-    lcdi2c_gDescriptor->driver_data.open_cnt--;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+#else
+    vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+#endif
+    ret = remap_pfn_range(vma, vma->vm_start, virt_to_phys(fb) >> PAGE_SHIFT,
+                          vma->vm_end - vma->vm_start, vma->vm_page_prot);
+    if (ret)
+        return ret;
 
-    module_put(THIS_MODULE);
-    SEM_UP(lcdi2c_gDescriptor);
+    vma->vm_ops = &lcdi2c_vm_ops;
+    vma->vm_private_data = lcd_handler;
+    lcdi2c_vm_open(vma);
     return SUCCESS;
 }
 
 static ssize_t lcdi2c_fopread(struct file *file, char __user *buffer,
                               size_t length, loff_t *offset) {
+    LcdFile_t *lcd_file = file->private_data;
     size_t to_copy = length < LCD_BUFFER_SIZE ? length : LCD_BUFFER_SIZE, rest = 0;
+    LcdSnapshot_t snapshot;
+
+    lcdsnapshot(lcd_file->lcd, &snapshot);
+    lcd_file->generation = snapshot.generation;
+    rest = copy_to_user(buffer, snapshot.raw_data, to_copy);
+
+    *offset = to_copy - rest;
+
+    return to_copy - rest;
+}
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+/*
+ * Terminal mode write, data is interpreted in chunks, each one is flushed
+ * as runs of changed cells. Whole write is consumed, unless copying fails.
+ */
+static ssize_t lcdi2c_term_write(LcdDescriptor_t *lcd_handler, const char __user *buffer,
+                                 size_t length, loff_t *offset) {
+    u8 chunk[LCD_TERM_CHUNK];
+    size_t written = 0, count;
+
+    while (written < length) {
+        //data is copied before the semaphore is taken, page faults don't hold other users
+        count = min_t(size_t, length - written, sizeof(chunk));
+        if (copy_from_user(chunk, buffer + written, count))
+            return written ? written : -EFAULT;
+
+        if (SEM_DOWN(lcd_handler)) {
+            return written ? written : -EBUSY;
+        }
+        lcdterm_write(lcd_handler, chunk, count);
+        lcdsetcursor(lcd_handler, lcd_handler->column, lcd_handler->row);
+        lcdi2c_flush(lcd_handler);
+        SEM_UP(lcd_handler);
+
+        written += count;
+    }
+    *offset += written;
+
+    return written;
+}
+
+/*
+ * Cell under the cursor of a file which claimed a window
+ */
+static u8 *lcdi2c_window_cell(LcdFile_t *lcd_file) {
+    const LcdWindowArgs_t *window = &lcd_file->window;
+
+    return lcd_file->lcd->raw_data + (window->row + lcd_file->row) * lcd_file->lcd->organization.columns +
+           window->column + lcd_file->column;
+}
+
+/*
+ * Moves cursor of a file by number of cells, row after row within its window,
+ * past the last cell it goes back to the first one
+ */
+static void lcdi2c_window_advance(LcdFile_t *lcd_file, uint cells) {
+    const LcdWindowArgs_t *window = &lcd_file->window;
+    uint offset;
+
+    offset = (lcd_file->row * window->columns + lcd_file->column + cells) % (window->columns * window->rows);
+    lcd_file->column = offset % window->columns;
+    lcd_file->row = offset / window->columns;
+}
+
+/*
+ * Write of a file which claimed a window, text goes to the cursor of the file and
+ * is clipped at the end of the window. Cursor of the display stays where it was.
+ */
+static ssize_t lcdi2c_window_write(LcdFile_t *lcd_file, const char __user *buffer,
+                                   size_t length, loff_t *offset) {
+    LcdDescriptor_t *lcd_handler = lcd_file->lcd;
+    const LcdWindowArgs_t *window = &lcd_file->window;
+    LcdBuffer_t data, cells;
+    size_t to_copy, rest;
+    uint room, count, used, i;
+    u8 *text;
+
+    //data is copied before the semaphore is taken, page faults don't hold other users
+    to_copy = length < LCD_BUFFER_SIZE ? length : LCD_BUFFER_SIZE;
+    rest = copy_from_user(data, buffer, to_copy);
+    to_copy -= rest;
+    if (!to_copy && length)
+        return -EFAULT;
+
+    if (SEM_DOWN(lcd_handler)) {
         return -EBUSY;
     }
 
-    rest = copy_to_user(buffer, lcdi2c_gDescriptor->raw_data, to_copy);
+    room = window->columns * window->rows - (lcd_file->row * window->columns + lcd_file->column);
+    if (lcd_handler->charset.mode == LCD_CHARSET_RAW) {
+        count = min_t(uint, room, to_copy);
+        used = count;
+        text = data;
+    } else {
+        //UTF-8 may take more bytes than cells, only what fitted is consumed
+        count = lcdcharset_translate(lcd_handler, data, to_copy, cells, room, &used);
+        text = cells;
+    }
+    for (i = 0; i < count; i++) {
+        *lcdi2c_window_cell(lcd_file) = text[i];
+        lcdi2c_window_advance(lcd_file, 1);
+    }
+    lcdi2c_flush(lcd_handler);
+    SEM_UP(lcd_handler);
 
-    *offset = to_copy - rest;
-    SEM_UP(lcdi2c_gDescriptor);
+    *offset += used;
 
-    return to_copy - rest;
+    return used;
+}
+
+/*
+ * Claims a window for the file, or gives the whole screen back, cursor of the
+ * file goes to the first cell of the window
+ */
+static long lcdi2c_setwindow(LcdFile_t *lcd_file, void __user *arg) {
+    LcdDescriptor_t *lcd_handler = lcd_file->lcd;
+    LcdWindowArgs_t window;
+
+    if (copy_from_user(&window, arg, sizeof(LcdWindowArgs_t)))
+        return -EIO;
+    if (!window.columns && !window.rows)
+        memset(&window, 0, sizeof(LcdWindowArgs_t));
+    else if (!window.columns || !window.rows ||
+             window.column + window.columns > lcd_handler->organization.columns ||
+             window.row + window.rows > lcd_handler->organization.rows)
+        return -EINVAL;
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -EBUSY;
+    }
+    lcd_file->window = window;
+    lcd_file->column = 0;
+    lcd_file->row = 0;
+    SEM_UP(lcd_handler);
+
+    return SUCCESS;
+}
+
+/*
+ * Cursor, character and clear calls of a file which claimed a window work within
+ * the window, with cursor of the file. Other calls are left to lcdi2c_ioctl.
+ */
+static long lcdi2c_window_ioctl(LcdFile_t *lcd_file, unsigned int ioctl_num, void __user *arg) {
+    LcdDescriptor_t *lcd_handler = lcd_file->lcd;
+    const LcdWindowArgs_t *window = &lcd_file->window;
+    const u8 columns = lcd_handler->organization.columns;
+    LcdPositionArgs_t position;
+    LcdCharArgs_t chr;
+    u8 row;
+
+    switch (ioctl_num) {
+        case LCD_IOCTL_GETPOSITION:
+            //cursor of the file is changed by its own calls only, no need to wait for the semaphore
+            position.column = lcd_file->column;
+            position.row = lcd_file->row;
+            return copy_to_user(arg, &position, sizeof(LcdPositionArgs_t)) ? -EIO : SUCCESS;
+        case LCD_IOCTL_SETPOSITION:
+            if (copy_from_user(&position, arg, sizeof(LcdPositionArgs_t)))
+                return -EIO;
+            break;
+        case LCD_IOCTL_SETCHAR:
+            if (copy_from_user(&chr, arg, sizeof(LcdCharArgs_t)))
+                return -EIO;
+            break;
+        case LCD_IOCTL_HOME:
+        case LCD_IOCTL_CLEAR:
+            break;
+        default:
+            return -ENOIOCTLCMD;
+    }
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -EBUSY;
+    }
+
+    switch (ioctl_num) {
+        case LCD_IOCTL_SETPOSITION:
+            //position out of the window is clipped to its edge
+            lcd_file->column = min_t(u8, position.column, window->columns - 1);
+            lcd_file->row = min_t(u8, position.row, window->rows - 1);
+            break;
+        case LCD_IOCTL_SETCHAR:
+            *lcdi2c_window_cell(lcd_file) = chr.value;
+            lcdi2c_window_advance(lcd_file, 1);
+            lcdi2c_flush(lcd_handler);
+            break;
+        case LCD_IOCTL_CLEAR:
+            for (row = window->row; row < window->row + window->rows; row++)
+                memset(lcd_handler->raw_data + row * columns + window->column, ' ', window->columns);
+            lcdi2c_flush(lcd_handler);
+            lcd_file->column = 0;
+            lcd_file->row = 0;
+            break;
+        case LCD_IOCTL_HOME:
+            lcd_file->column = 0;
+            lcd_file->row = 0;
+            break;
+    }
+    SEM_UP(lcd_handler);
+
+    return SUCCESS;
 }
 
 static ssize_t lcdi2c_fopwrite(struct file *file, const char __user *buffer,
                                size_t length, loff_t *offset) {
-    size_t to_copy;
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
+    LcdFile_t *lcd_file = file->private_data;
+    LcdBuffer_t data, cells;
+    size_t to_copy, room;
     size_t rest;
+    uint count, used;
     u8 *buffer_ptr, *buffer_end;
+    ssize_t written;
+
+    if (FILE_WINDOWED(lcd_file))
+        return lcdi2c_window_write(lcd_file, buffer, length, offset);
+    if (kfifo_initialized(&lcd_handler->driver_data.stream)) {
+        written = lcdi2c_stream_write(lcd_handler, file, buffer, length);
+        if (written > 0)
+            *offset += written;
+        return written;
+    }
+    if (lcd_handler->term.enabled)
+        return lcdi2c_term_write(lcd_handler, buffer, length, offset);
+
+    //data is copied before the semaphore is taken, page faults don't hold other users
+    to_copy = length < LCD_BUFFER_SIZE ? length : LCD_BUFFER_SIZE;
+    rest = copy_from_user(data, buffer, to_copy);
+    to_copy -= rest;
+    if (!to_copy && length)
+        return -EFAULT;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    if (SEM_DOWN(lcd_handler)) {
         return -EBUSY;
     }
 
-    to_copy = length < LCD_BUFFER_SIZE ? length : LCD_BUFFER_SIZE;
-    buffer_ptr = lcdi2c_gDescriptor->raw_data + (lcdi2c_gDescriptor->column + (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns));
-    buffer_end = lcdi2c_gDescriptor->raw_data + LCD_BUFFER_SIZE;
-    to_copy = buffer_end - buffer_ptr < to_copy ? buffer_end - buffer_ptr : to_copy;
-    rest = copy_from_user(buffer_ptr, buffer, to_copy);
-    lcdi2c_gDescriptor->column = (lcdi2c_gDescriptor->column + to_copy - rest) % lcdi2c_gDescriptor->organization.columns;
-    lcdi2c_gDescriptor->row = (lcdi2c_gDescriptor->row + (lcdi2c_gDescriptor->column + to_copy - rest) /
-            lcdi2c_gDescriptor->organization.columns) % lcdi2c_gDescriptor->organization.rows;
+    buffer_ptr = lcd_handler->raw_data + (lcd_handler->column + (lcd_handler->row * lcd_handler->organization.columns));
+    buffer_end = lcd_handler->raw_data + LCD_BUFFER_SIZE;
+    room = buffer_end - buffer_ptr;
+    if (lcd_handler->charset.mode == LCD_CHARSET_RAW) {
+        count = room < to_copy ? room : to_copy;
+        memcpy(buffer_ptr, data, count);
+        to_copy = count;
+    } else {
+        //UTF-8 may take more bytes than cells, only what fitted is consumed
+        count = lcdcharset_translate(lcd_handler, data, to_copy, cells, room, &used);
+        memcpy(buffer_ptr, cells, count);
+        to_copy = used;
+    }
+    lcd_handler->column = (lcd_handler->column + count) % lcd_handler->organization.columns;
+    lcd_handler->row = (lcd_handler->row + (lcd_handler->column + count) /
+            lcd_handler->organization.columns) % lcd_handler->organization.rows;
 
-    lcdsetcursor(lcdi2c_gDescriptor, lcdi2c_gDescriptor->column, lcdi2c_gDescriptor->row);
+    lcdsetcursor(lcd_handler, lcd_handler->column, lcd_handler->row);
 
-    lcdflushbuffer(lcdi2c_gDescriptor);
+    lcdi2c_flush(lcd_handler);
 
-    *offset = to_copy - rest;
-    SEM_UP(lcdi2c_gDescriptor);
+    *offset = to_copy;
+    SEM_UP(lcd_handler);
 
-    return to_copy - rest;
+    return to_copy;
 }
 
 loff_t lcdi2c_lseek(struct file *file, loff_t offset, int orig) {
+    LcdFile_t *lcd_file = file->private_data;
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
     u8 memaddr, oldoffset;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    if (SEM_DOWN(lcd_handler)) {
         return -EBUSY;
     }
-    memaddr = lcdi2c_gDescriptor->column + (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns);
+    if (FILE_WINDOWED(lcd_file)) {
+        //file with a window seeks within it, cursor of the display stays
+        oldoffset = lcd_file->column + lcd_file->row * lcd_file->window.columns;
+        lcdi2c_window_advance(lcd_file, (u8) offset);
+        SEM_UP(lcd_handler);
+        return oldoffset;
+    }
+    memaddr = lcd_handler->column + (lcd_handler->row * lcd_handler->organization.columns);
     oldoffset = memaddr;
-    memaddr = (memaddr + (u8) offset) % (lcdi2c_gDescriptor->organization.rows * lcdi2c_gDescriptor->organization.columns);
-    lcdi2c_gDescriptor->column = (memaddr % lcdi2c_gDescriptor->organization.columns);
-    lcdi2c_gDescriptor->row = (memaddr / lcdi2c_gDescriptor->organization.columns);
-    lcdsetcursor(lcdi2c_gDescriptor, lcdi2c_gDescriptor->column, lcdi2c_gDescriptor->row);
-    SEM_UP(lcdi2c_gDescriptor);
+    memaddr = (memaddr + (u8) offset) % (lcd_handler->organization.rows * lcd_handler->organization.columns);
+    lcd_handler->column = (memaddr % lcd_handler->organization.columns);
+    lcd_handler->row = (memaddr / lcd_handler->organization.columns);
+    lcdsetcursor(lcd_handler, lcd_handler->column, lcd_handler->row);
+    SEM_UP(lcd_handler);
 
     return oldoffset;
 }
 
-static long lcdi2c_ioctl(struct file *file,
-                         unsigned int ioctl_num,
-                         unsigned long __user arg) {
-    u8 buff_offset, i;
-    long status = SUCCESS;
-    size_t to_copy = 0;
-    LcdCharArgs_t *char_data;
-    LcdCharArgs_t local_char;
-    LcdBoolArgs_t *bool_data;
-    LcdBoolArgs_t local_bool;
-    LcdPositionArgs_t *position_data;
+/*
+ * Getters are served from the published snapshot, they never wait
+ * for the semaphore held during bus transfers
+ */
+static long lcdi2c_ioctl_get(LcdDescriptor_t *lcd_handler, unsigned int ioctl_num, void __user *arg) {
+    const u8 columns = lcd_handler->organization.columns;
     LcdCustomCharArgs_t local_custom_char;
-    LcdCustomCharArgs_t *custom_char;
-    LcdLineArgs_t *line_data;
-    LcdBufferArgs_t *buffer_data;
-
+    LcdPositionArgs_t local_position;
+    LcdBoolArgs_t local_bool;
+    LcdCharArgs_t local_char;
+    LcdSnapshot_t snapshot;
+    long status = SUCCESS;
+    u8 buff_offset;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -EBUSY;
-    }
+    lcdsnapshot(lcd_handler, &snapshot);
 
     switch (ioctl_num) {
-        case LCD_IOCTL_SETCHAR:
-            char_data = (LcdCharArgs_t *) arg;
-            if (copy_from_user(&local_char, char_data, sizeof(LcdCharArgs_t))) {
-                status = -EIO;
-                break;
-            }
-            buff_offset = (1 + lcdi2c_gDescriptor->column + (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns)) % LCD_BUFFER_SIZE;
-            lcdwrite(lcdi2c_gDescriptor, local_char.value);
-            lcdi2c_gDescriptor->column = (buff_offset % lcdi2c_gDescriptor->organization.columns);
-            lcdi2c_gDescriptor->row = (buff_offset / lcdi2c_gDescriptor->organization.columns);
-            lcdsetcursor(lcdi2c_gDescriptor, lcdi2c_gDescriptor->column, lcdi2c_gDescriptor->row);
-            break;
         case LCD_IOCTL_GETCHAR:
-            char_data = (LcdCharArgs_t *) arg;
-            buff_offset = (lcdi2c_gDescriptor->column + (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns)) % LCD_BUFFER_SIZE;
-            local_char.value = lcdi2c_gDescriptor->raw_data[buff_offset];
-            if (copy_to_user(char_data, &local_char.value, sizeof(LcdCharArgs_t))) {
+            buff_offset = (snapshot.column + (snapshot.row * columns)) % LCD_BUFFER_SIZE;
+            local_char.value = snapshot.raw_data[buff_offset];
+            if (copy_to_user(arg, &local_char, sizeof(LcdCharArgs_t)))
                 status = -EIO;
-            }
             break;
         case LCD_IOCTL_GETLINE:
-            line_data = (LcdLineArgs_t *) arg;
-            buff_offset = (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns) % LCD_BUFFER_SIZE;
-            if (copy_to_user(&line_data->line, lcdi2c_gDescriptor->raw_data + buff_offset, lcdi2c_gDescriptor->organization.columns)) {
+            buff_offset = (snapshot.row * columns) % LCD_BUFFER_SIZE;
+            if (copy_to_user(arg, snapshot.raw_data + buff_offset, columns))
                 status = -EIO;
-            }
             break;
-        case LCD_IOCTL_SETLINE:
-            line_data = (LcdLineArgs_t *) arg;
-            buff_offset = (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns) % LCD_BUFFER_SIZE;
-            if (copy_from_user(lcdi2c_gDescriptor->raw_data + buff_offset, line_data->line, lcdi2c_gDescriptor->organization.columns)) {
+        case LCD_IOCTL_GETBUFFER:
+            if (copy_to_user(arg, snapshot.raw_data, LCD_BUFFER_SIZE))
                 status = -EIO;
-            } else {
-                lcdflushbuffer(lcdi2c_gDescriptor);
-            }
             break;
-        case LCD_IOCTL_GETBUFFER:
-            buffer_data = (LcdBufferArgs_t *) arg;
-            if (copy_to_user(&buffer_data->buffer, lcdi2c_gDescriptor->raw_data, LCD_BUFFER_SIZE)) {
+        case LCD_IOCTL_GETPOSITION:
+            local_position.column = snapshot.column;
+            local_position.row = snapshot.row;
+            if (copy_to_user(arg, &local_position, sizeof(LcdPositionArgs_t)))
                 status = -EIO;
-            }
             break;
-        case LCD_IOCTL_SETBUFFER:
-            buffer_data = (LcdBufferArgs_t *) arg;
-            if (copy_from_user(lcdi2c_gDescriptor->raw_data, buffer_data->buffer, LCD_BUFFER_SIZE)) {
+        case LCD_IOCTL_GETCURSOR:
+        case LCD_IOCTL_GETBLINK:
+        case LCD_IOCTL_GETBACKLIGHT:
+            if (ioctl_num == LCD_IOCTL_GETCURSOR)
+                local_bool.value = snapshot.cursor ? 1 : 0;
+            else if (ioctl_num == LCD_IOCTL_GETBLINK)
+                local_bool.value = snapshot.blink ? 1 : 0;
+            else
+                local_bool.value = snapshot.backlight ? 1 : 0;
+            if (copy_to_user(arg, &local_bool, sizeof(LcdBoolArgs_t)))
+                status = -EIO;
+            break;
+        case LCD_IOCTL_GETCUSTOMCHAR:
+            if (copy_from_user(&local_custom_char, arg, sizeof(LcdCustomCharArgs_t))) {
                 status = -EIO;
-            } else {
-                lcdflushbuffer(lcdi2c_gDescriptor);
+                break;
             }
+            memcpy(local_custom_char.custom_char, snapshot.custom_chars[local_custom_char.index & 0x07],
+                   sizeof(CustomChar_t));
+            if (copy_to_user(arg, &local_custom_char, sizeof(LcdCustomCharArgs_t)))
+                status = -EIO;
             break;
+    }
+    if (status != SUCCESS)
+        dev_err(lcd_handler->driver_data.lcdi2c_device, "IOCTL failed: 0x%02X\n", ioctl_num);
+
+    return status;
+}
+
+/*
+ * Whole published state together with its generation, which is
+ * remembered as seen by this file
+ */
+static long lcdi2c_getstate(LcdFile_t *lcd_file, void __user *arg) {
+    LcdSnapshot_t snapshot;
+
+    lcdsnapshot(lcd_file->lcd, &snapshot);
+    if (copy_to_user(arg, &snapshot, sizeof(LcdSnapshot_t))) {
+        dev_err(lcd_file->lcd->driver_data.lcdi2c_device, "IOCTL failed: 0x%02X\n", LCD_IOCTL_GETSTATE);
+        return -EIO;
+    }
+    lcd_file->generation = snapshot.generation;
+
+    return SUCCESS;
+}
+
+static long lcdi2c_ioctl(struct file *file,
+                         unsigned int ioctl_num,
+                         unsigned long __user arg) {
+    LcdFile_t *lcd_file = file->private_data;
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
+    const u8 columns = lcd_handler->organization.columns;
+    u8 buff_offset;
+    long status = SUCCESS;
+    union {
+        LcdCharArgs_t chr;
+        LcdBoolArgs_t flag;
+        LcdLineArgs_t line;
+        LcdBufferArgs_t buffer;
+        LcdPositionArgs_t position;
+        LcdCustomCharArgs_t custom_char;
+        LcdScrollArgs_t scroll;
+        LcdCommitArgs_t commit;
+        LcdAnimationArgs_t animation;
+    } local;
+
+    if (FILE_WINDOWED(lcd_file)) {
+        status = lcdi2c_window_ioctl(lcd_file, ioctl_num, (void __user *) arg);
+        if (status != -ENOIOCTLCMD)
+            return status;
+        status = SUCCESS;
+    }
+
+    switch (ioctl_num) {
+        case LCD_IOCTL_SETWINDOW:
+            return lcdi2c_setwindow(lcd_file, (void __user *) arg);
+        case LCD_IOCTL_SYNC:
+            lcdi2c_sync(lcd_handler);
+            return SUCCESS;
+        case LCD_IOCTL_BATCH:
+            return lcdi2c_batch(lcd_handler, (void __user *) arg);
+        case LCD_IOCTL_SETGLYPH:
+            return lcdi2c_glyph(lcd_handler, (void __user *) arg);
+        case LCD_IOCTL_MARQUEE:
+            return lcdi2c_marquee(lcd_handler, (void __user *) arg);
+        case LCD_IOCTL_GETSTATE:
+            return lcdi2c_getstate(lcd_file, (void __user *) arg);
+        case LCD_IOCTL_GETCHAR:
+        case LCD_IOCTL_GETLINE:
+        case LCD_IOCTL_GETBUFFER:
         case LCD_IOCTL_GETPOSITION:
-            position_data = (LcdPositionArgs_t *) arg;
-            put_user(lcdi2c_gDescriptor->column, &position_data->column);
-            put_user(lcdi2c_gDescriptor->row, &position_data->row);
+        case LCD_IOCTL_GETCURSOR:
+        case LCD_IOCTL_GETBLINK:
+        case LCD_IOCTL_GETBACKLIGHT:
+        case LCD_IOCTL_GETCUSTOMCHAR:
+            return lcdi2c_ioctl_get(lcd_handler, ioctl_num, (void __user *) arg);
+    }
+
+    //argument is copied before the semaphore is taken, page faults don't hold other users
+    if ((_IOC_DIR(ioctl_num) & _IOC_WRITE) && arg) {
+        if (_IOC_SIZE(ioctl_num) > sizeof(local) ||
+            copy_from_user(&local, (void __user *) arg, _IOC_SIZE(ioctl_num))) {
+            dev_err(lcd_handler->driver_data.lcdi2c_device, "IOCTL failed: 0x%02X\n", ioctl_num);
+            return -EIO;
+        }
+    }
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -EBUSY;
+    }
+
+    switch (ioctl_num) {
+        case LCD_IOCTL_SETCHAR:
+            buff_offset = (1 + lcd_handler->column + (lcd_handler->row * columns)) % LCD_BUFFER_SIZE;
+            lcdwrite(lcd_handler, local.chr.value);
+            lcd_handler->column = (buff_offset % columns);
+            lcd_handler->row = (buff_offset / columns);
+            lcdsetcursor(lcd_handler, lcd_handler->column, lcd_handler->row);
+            break;
+        case LCD_IOCTL_SETLINE:
+            buff_offset = (lcd_handler->row * columns) % LCD_BUFFER_SIZE;
+            memcpy(lcd_handler->raw_data + buff_offset, local.line.line, columns);
+            lcdi2c_flush(lcd_handler);
+            break;
+        case LCD_IOCTL_SETBUFFER:
+            memcpy(lcd_handler->raw_data, local.buffer.buffer, LCD_BUFFER_SIZE);
+            lcdi2c_flush(lcd_handler);
             break;
         case LCD_IOCTL_SETPOSITION:
-            position_data = (LcdPositionArgs_t *) arg;
-            get_user(lcdi2c_gDescriptor->column, &position_data->column);
-            get_user(lcdi2c_gDescriptor->row, &position_data->row);
-            lcdsetcursor(lcdi2c_gDescriptor, lcdi2c_gDescriptor->column, lcdi2c_gDescriptor->row);
+            lcdsetcursor(lcd_handler, local.position.column, local.position.row);
             break;
         case LCD_IOCTL_RESET:
-            lcdinit(lcdi2c_gDescriptor, lcdi2c_gDescriptor->organization.topology);
+            lcdinit(lcd_handler, lcd_handler->organization.topology);
             break;
         case LCD_IOCTL_HOME:
-            lcdhome(lcdi2c_gDescriptor);
-            break;
-        case LCD_IOCTL_GETCURSOR:
-            bool_data = (LcdBoolArgs_t *) arg;
-            local_bool.value = lcdi2c_gDescriptor->cursor ? 1 : 0;
-            if (copy_to_user(bool_data, &local_bool, sizeof(LcdBoolArgs_t))) {
-                status = -EIO;
-            }
-            break;
-        case LCD_IOCTL_SETCURSOR:
-            bool_data = (LcdBoolArgs_t *) arg;
-            if (copy_from_user(&local_bool, bool_data, sizeof(LcdBoolArgs_t))) {
-                status = -EIO;
-                break;
-            }
-            lcdcursor(lcdi2c_gDescriptor, local_bool.value == 1);
-            break;
-        case LCD_IOCTL_GETBLINK:
-            bool_data = (LcdBoolArgs_t *) arg;
-            local_bool.value = lcdi2c_gDescriptor->blink ? 1 : 0;
-            if (copy_to_user(bool_data, &local_bool, sizeof(LcdBoolArgs_t))) {
-                status = -EIO;
-            }
+            lcdhome(lcd_handler);
             break;
-        case LCD_IOCTL_SETBLINK:
-            bool_data = (LcdBoolArgs_t *) arg;
-            if (copy_from_user(&local_bool, bool_data, sizeof(LcdBoolArgs_t))) {
-                status = -EIO;
-                break;
-            }
-            lcdblink(lcdi2c_gDescriptor, local_bool.value == 1);
+        case LCD_IOCTL_SETCURSOR:
+            lcdcursor(lcd_handler, local.flag.value == 1);
             break;
-        case LCD_IOCTL_GETBACKLIGHT:
-            bool_data = (LcdBoolArgs_t *) arg;
-            local_bool.value = lcdi2c_gDescriptor->backlight ? 1 : 0;
-            if (copy_to_user(bool_data, &local_bool, sizeof(LcdBoolArgs_t))) {
-                status = -EIO;
-            }
+        case LCD_IOCTL_SETBLINK:
+            lcdblink(lcd_handler, local.flag.value == 1);
             break;
         case LCD_IOCTL_SETBACKLIGHT:
-            bool_data = (LcdBoolArgs_t *) arg;
-            if (copy_from_user(&local_bool, bool_data, sizeof(LcdBoolArgs_t))) {
-                status = -EIO;
-                break;
-            }
-            lcdsetbacklight(lcdi2c_gDescriptor, local_bool.value == 1);
+            lcdsetbacklight(lcd_handler, local.flag.value == 1);
             break;
         case LCD_IOCTL_SCROLLHZ:
-            bool_data = (LcdBoolArgs_t *) arg;
-            if (copy_from_user(&local_bool, bool_data, sizeof(LcdBoolArgs_t))) {
-                status = -EIO;
-                break;
-            }
-            lcdscrollhoriz(lcdi2c_gDescriptor, local_bool.value == 1);
+            lcdscrollhoriz(lcd_handler, local.flag.value == 1);
             break;
         case LCD_IOCTL_SCROLLVERT:
-            LcdScrollArgs_t *scroll_data = (LcdScrollArgs_t *) arg;
-            LcdScrollArgs_t local_scroll;
-            if(copy_from_user(&local_scroll, scroll_data, sizeof(LcdScrollArgs_t))) {
-                status = -EIO;
-                break;
-            }
-            lcdscrollvert(lcdi2c_gDescriptor, local_scroll.line, sizeof(local_scroll.line), local_scroll.direction);
-            break;
-        case LCD_IOCTL_GETCUSTOMCHAR:
-            custom_char = (LcdCustomCharArgs_t *) arg;
-            for (i = 0; i < 8; i++)
-                put_user(custom_char->custom_char[i], &lcdi2c_gDescriptor->custom_chars[custom_char->index][i]);
+            lcdscrollbuffer(lcd_handler, local.scroll.line, sizeof(local.scroll.line), local.scroll.direction);
+            lcdi2c_flush(lcd_handler);
             break;
         case LCD_IOCTL_SETCUSTOMCHAR:
-            to_copy = copy_from_user(&local_custom_char, (void*) arg, sizeof(LcdCustomCharArgs_t));
-            if (to_copy) {
-                status = -EIO;
+            lcdcustomchar(lcd_handler, local.custom_char.index, local.custom_char.custom_char);
+            break;
+        case LCD_IOCTL_CLEAR:
+            lcdclear(lcd_handler);
+            break;
+        case LCD_IOCTL_COMMIT:
+            lcdi2c_commit(lcd_handler, arg ? &local.commit : NULL);
+            break;
+        case LCD_IOCTL_SETPAGE:
+            if (!lcdcanflip(lcd_handler)) {
+                status = -EOPNOTSUPP;
                 break;
             }
-            lcdcustomchar(lcdi2c_gDescriptor, local_custom_char.index, local_custom_char.custom_char);
+            //page goes off the screen, so it's sent by the worker while the caller goes on
+            memcpy(lcd_handler->back, local.buffer.buffer, LCD_BUFFER_SIZE);
+            lcd_handler->back_dirty = 1;
+            mod_delayed_work(lcd_handler->driver_data.wq, &lcd_handler->driver_data.flush_work, 0);
             break;
-        case LCD_IOCTL_CLEAR:
-            lcdclear(lcdi2c_gDescriptor);
+        case LCD_IOCTL_FLIP:
+            status = lcdflip(lcd_handler);
+            break;
+        case LCD_IOCTL_ANIMATE:
+            status = lcdeffects_animate(lcd_handler, &local.animation);
+            if (status == SUCCESS)
+                queue_work(lcd_handler->driver_data.wq, &lcd_handler->driver_data.effects_work);
             break;
         default:
-            dev_err(lcdi2c_gDescriptor->driver_data.lcdi2c_device, "Unknown IOCTL: 0x%02X\n", ioctl_num);
+            dev_err(lcd_handler->driver_data.lcdi2c_device, "Unknown IOCTL: 0x%02X\n", ioctl_num);
             break;
     }
     if (status!= SUCCESS)
-        dev_err(lcdi2c_gDescriptor->driver_data.lcdi2c_device, "IOCTL failed: 0x%02X\n", ioctl_num);
-    SEM_UP(lcdi2c_gDescriptor);
+        dev_err(lcd_handler->driver_data.lcdi2c_device, "IOCTL failed: 0x%02X\n", ioctl_num);
+    SEM_UP(lcd_handler);
 
     return status;
 }
 
+/*
+ * Runs an operation between op_start and op_end tracepoints, op_end gets its return value
+ */
+#define LCDI2C_TRACED(lcd_handler, kind, code, name, call) ({ \
+    typeof(call) _ret; \
+    trace_lcdi2c_op_start(lcd_handler, kind, code, name); \
+    _ret = (call); \
+    trace_lcdi2c_op_end(lcd_handler, kind, code, name, (long) _ret); \
+    _ret; })
+
+static const char *lcdi2c_ioctl_name(unsigned int ioctl_num) {
+    for (int i = 0; i < ARRAY_SIZE(ioControls); i++) {
+        if (ioControls[i].ioctl_code == ioctl_num)
+            return ioControls[i].name;
+    }
+    return "UNKNOWN";
+}
+
+/*
+ * File operations of the device, each one traced on entry and return
+ */
+static int lcdi2c_traced_open(struct inode *inode, struct file *file) {
+    LcdDescriptor_t *lcd_handler = container_of(inode->i_cdev, LcdDescriptor_t, driver_data.cdev);
+
+    return LCDI2C_TRACED(lcd_handler, LCDI2C_OP_FOP, 0, "open", lcdi2c_open(inode, file));
+}
+
+static int lcdi2c_traced_release(struct inode *inode, struct file *file) {
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
+
+    return LCDI2C_TRACED(lcd_handler, LCDI2C_OP_FOP, 0, "release", lcdi2c_release(inode, file));
+}
+
+static ssize_t lcdi2c_traced_read(struct file *file, char __user *buffer, size_t length, loff_t *offset) {
+    if (FILE_GONE(file))
+        return -ENODEV;
+    return LCDI2C_TRACED(FILE_LCD(file), LCDI2C_OP_FOP, 0, "read",
+                         lcdi2c_fopread(file, buffer, length, offset));
+}
+
+static ssize_t lcdi2c_traced_write(struct file *file, const char __user *buffer, size_t length, loff_t *offset) {
+    if (FILE_GONE(file))
+        return -ENODEV;
+    return LCDI2C_TRACED(FILE_LCD(file), LCDI2C_OP_FOP, 0, "write",
+                         lcdi2c_fopwrite(file, buffer, length, offset));
+}
+
+static loff_t lcdi2c_traced_lseek(struct file *file, loff_t offset, int orig) {
+    if (FILE_GONE(file))
+        return -ENODEV;
+    return LCDI2C_TRACED(FILE_LCD(file), LCDI2C_OP_FOP, 0, "llseek", lcdi2c_lseek(file, offset, orig));
+}
+
+static long lcdi2c_traced_ioctl(struct file *file, unsigned int ioctl_num, unsigned long arg) {
+    LcdDescriptor_t *lcd_handler = FILE_LCD(file);
+    const ktime_t start = ktime_get();
+    long ret;
+
+    if (FILE_GONE(file))
+        return -ENODEV;
+
+    ret = LCDI2C_TRACED(lcd_handler, LCDI2C_OP_IOCTL, ioctl_num, lcdi2c_ioctl_name(ioctl_num),
+                        lcdi2c_ioctl(file, ioctl_num, arg));
+    lcdstats_record(&lcd_handler->stats.ioctl, ktime_to_ns(ktime_sub(ktime_get(), start)));
+    return ret;
+}
+
+static int lcdi2c_traced_fsync(struct file *file, loff_t start, loff_t end, int datasync) {
+    if (FILE_GONE(file))
+        return -ENODEV;
+    return LCDI2C_TRACED(FILE_LCD(file), LCDI2C_OP_FOP, 0, "fsync", lcdi2c_fsync(file, start, end, datasync));
+}
+
+static int lcdi2c_traced_mmap(struct file *file, struct vm_area_struct *vma) {
+    if (FILE_GONE(file))
+        return -ENODEV;
+    return LCDI2C_TRACED(FILE_LCD(file), LCDI2C_OP_FOP, 0, "mmap", lcdi2c_mmap(file, vma));
+}
+
+static __poll_t lcdi2c_traced_poll(struct file *file, poll_table *wait) {
+    return LCDI2C_TRACED(FILE_LCD(file), LCDI2C_OP_FOP, 0, "poll", lcdi2c_poll(file, wait));
+}
+
+/*
+ * Sysfs accesses, traced under the attribute name before handler of the attribute is called
+ */
+static ssize_t lcdi2c_attr_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    Lcdi2cAttribute_t *lcd_attr = container_of(attr, Lcdi2cAttribute_t, attr);
+
+    if (!lcd_attr->show)
+        return -EIO;
+    return LCDI2C_TRACED((LcdDescriptor_t *) dev_get_drvdata(dev), LCDI2C_OP_SHOW, 0, attr->attr.name,
+                         lcd_attr->show(dev, attr, buf));
+}
+
+static ssize_t lcdi2c_attr_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    Lcdi2cAttribute_t *lcd_attr = container_of(attr, Lcdi2cAttribute_t, attr);
+
+    if (!lcd_attr->store)
+        return -EIO;
+    return LCDI2C_TRACED((LcdDescriptor_t *) dev_get_drvdata(dev), LCDI2C_OP_STORE, 0, attr->attr.name,
+                         lcd_attr->store(dev, attr, buf, count));
+}
+
 static ssize_t lcdi2c_reset(struct device *dev, struct device_attribute *attr,
                             const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
 
     if (count > 0 && buf[0] == '1')
-        lcdinit(lcdi2c_gDescriptor, topo);
+        lcdinit(lcd_handler, lcd_handler->organization.topology);
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_backlight(struct device *dev,
                                 struct device_attribute *attr,
                                 const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
     u8 res;
     int er;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     er = kstrtou8(buf, 10, &res);
     if (er == 0) {
-        lcdsetbacklight(lcdi2c_gDescriptor, res);
+        lcdsetbacklight(lcd_handler, res);
         er = count;
     } else if (er == -ERANGE)
         dev_err(dev, "Brightness parameter out of range (0-255).");
@@ -559,113 +1657,93 @@ static ssize_t lcdi2c_backlight(struct device *dev,
     else
         dev_err(dev, "Brightness parameter wasn't properly converted! err: %d", er);
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return er;
 }
 
 static ssize_t lcdi2c_backlight_show(struct device *dev,
                                      struct device_attribute *attr, char *buf) {
-    int count = 0;
-
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
-
-    if (buf)
-        count = snprintf(buf, PAGE_SIZE, "%d", lcdi2c_gDescriptor->backlight);
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSnapshot_t snapshot;
 
-    SEM_UP(lcdi2c_gDescriptor);
-    return count;
+    lcdsnapshot(lcd_handler, &snapshot);
+    return snprintf(buf, PAGE_SIZE, "%d", snapshot.backlight);
 }
 
 static ssize_t lcdi2c_cursorpos(struct device *dev,
                                 struct device_attribute *attr,
                                 const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (count >= 2) {
         count = 2;
-        lcdsetcursor(lcdi2c_gDescriptor, buf[0], buf[1]);
+        lcdsetcursor(lcd_handler, buf[0], buf[1]);
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_cursorpos_show(struct device *dev,
                                      struct device_attribute *attr,
                                      char *buf) {
-    ssize_t count = 0;
-
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
-
-    if (buf) {
-        count = 2;
-        buf[0] = lcdi2c_gDescriptor->column;
-        buf[1] = lcdi2c_gDescriptor->row;
-    }
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSnapshot_t snapshot;
 
-    SEM_UP(lcdi2c_gDescriptor);
-    return count;
+    lcdsnapshot(lcd_handler, &snapshot);
+    buf[0] = snapshot.column;
+    buf[1] = snapshot.row;
+    return 2;
 }
 
 static ssize_t lcdi2c_data(struct device *dev,
                            struct device_attribute *attr,
                            const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
     u8 i, addr, memaddr;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (count > 0) {
-        memaddr = lcdi2c_gDescriptor->column + (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns);
+        memaddr = lcd_handler->column + (lcd_handler->row * lcd_handler->organization.columns);
         for (i = 0; i < count; i++) {
-            addr = (memaddr + i) % (lcdi2c_gDescriptor->organization.columns * lcdi2c_gDescriptor->organization.rows);
-            lcdi2c_gDescriptor->raw_data[addr] = buf[i];
+            addr = (memaddr + i) % (lcd_handler->organization.columns * lcd_handler->organization.rows);
+            lcd_handler->raw_data[addr] = buf[i];
         }
-        lcdflushbuffer(lcdi2c_gDescriptor);
+        lcdi2c_flush(lcd_handler);
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_data_show(struct device *dev,
                                 struct device_attribute *attr, char *buf) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
-
-    if (buf) {
-        for (u8 i = 0; i < (lcdi2c_gDescriptor->organization.columns * lcdi2c_gDescriptor->organization.rows); i++) {
-            buf[i] = lcdi2c_gDescriptor->raw_data[i];
-        }
-    }
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    const u8 count = lcd_handler->organization.columns * lcd_handler->organization.rows;
+    LcdSnapshot_t snapshot;
 
-    SEM_UP(lcdi2c_gDescriptor);
-    return (lcdi2c_gDescriptor->organization.columns * lcdi2c_gDescriptor->organization.rows);
+    lcdsnapshot(lcd_handler, &snapshot);
+    memcpy(buf, snapshot.raw_data, count);
+    return count;
 }
 
 static ssize_t lcdi2c_meta_show(struct device *dev,
                                 struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
 
     ssize_t count = 0;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
-
-
     if (buf) {
         char tmp[SHORT_STR_LEN], lines[META_BUFFER_LEN];
         memset(lines, 0, META_BUFFER_LEN);
-        for (int i = 0; i < lcdi2c_gDescriptor->organization.rows; i++) {
-            snprintf(tmp, SHORT_STR_LEN, "%d: 0x%02X, ", i, lcdi2c_gDescriptor->organization.addresses[i]);
+        for (int i = 0; i < lcd_handler->organization.rows; i++) {
+            snprintf(tmp, SHORT_STR_LEN, "%d: 0x%02X, ", i, lcd_handler->organization.addresses[i]);
             strncat(lines, tmp, META_BUFFER_LEN);
         }
 
@@ -684,19 +1762,41 @@ static ssize_t lcdi2c_meta_show(struct device *dev,
                             "       data-lines: {4: %d, 5: %d, 6: %d, 7: %d,}\n"
                             "       busno: %d\n"
                             "       reg: 0x%02X\n"
+                            "       transport: {burst: %d, max-write-len: %d}\n"
+                            "       timing: {bus-hz: %u, exec-ns: %u, clear-ns: %u, busy-flag: %d}\n"
+                            "       framebuffer: {size: %zu, cells: %zu, custom-chars: %zu}\n"
+                            "       stream: {size: %u, used: %u}\n"
+                            "       pages: %d\n"
+                            "       charset: %s\n"
+                            "       terminal: %d\n"
                             "       ioctls:\n",
-                         lcdi2c_gDescriptor->show_welcome_screen,
-                         lcdi2c_gDescriptor->organization.topology,
-                         lcdi2c_gDescriptor->organization.toponame,
-                         lcdi2c_gDescriptor->organization.rows,
-                         lcdi2c_gDescriptor->organization.columns,
+                         lcd_handler->show_welcome_screen,
+                         lcd_handler->organization.topology,
+                         lcd_handler->organization.toponame,
+                         lcd_handler->organization.rows,
+                         lcd_handler->organization.columns,
                          lines,
                          LCD_BUFFER_SIZE,
                          LCD_MAX_LINE_LENGTH,
                          PIN_RS, PIN_RW, PIN_EN, PIN_BACKLIGHT,
                          PIN_DB4, PIN_DB5, PIN_DB6, PIN_DB7,
-                         lcdi2c_gDescriptor->driver_data.client->adapter->nr,
-                         lcdi2c_gDescriptor->driver_data.client->addr);
+                         lcd_handler->driver_data.client->adapter->nr,
+                         lcd_handler->driver_data.client->addr,
+                         lcd_handler->xfer.burst,
+                         lcd_handler->xfer.max_length,
+                         lcd_handler->timing.bus_hz,
+                         lcd_handler->timing.exec_ns,
+                         lcd_handler->timing.clear_ns,
+                         lcd_handler->busy_poll,
+                         sizeof(LcdFramebuffer_t),
+                         offsetof(LcdFramebuffer_t, cells),
+                         offsetof(LcdFramebuffer_t, custom_chars),
+                         kfifo_initialized(&lcd_handler->driver_data.stream) ?
+                                 kfifo_size(&lcd_handler->driver_data.stream) : 0,
+                         kfifo_len(&lcd_handler->driver_data.stream),
+                         lcdcanflip(lcd_handler) ? 2 : 1,
+                         charsetnames[lcd_handler->charset.mode],
+                         lcd_handler->term.enabled);
 
         for (int i = 0; i < (sizeof(ioControls) / sizeof(IOCTLDescription_t)); i++) {
             count += snprintf(lines, META_BUFFER_LEN, "                 %s: 0x%02X\n",
@@ -707,236 +1807,572 @@ static ssize_t lcdi2c_meta_show(struct device *dev,
         strncat(buf, lines, PAGE_SIZE);
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
     return count;
 }
 
 static ssize_t lcdi2c_cursor(struct device *dev,
                              struct device_attribute *attr,
                              const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (count > 0) {
-        lcdi2c_gDescriptor->cursor = (buf[0] == '1');
-        lcdcursor(lcdi2c_gDescriptor, lcdi2c_gDescriptor->cursor);
+        lcd_handler->cursor = (buf[0] == '1');
+        lcdcursor(lcd_handler, lcd_handler->cursor);
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_cursor_show(struct device *dev,
                                   struct device_attribute *attr, char *buf) {
-    ssize_t count = 0;
-
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
-
-    if (buf)
-        count = snprintf(buf, PAGE_SIZE, "%c", lcdi2c_gDescriptor->cursor ? '1' : '0');
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSnapshot_t snapshot;
 
-    SEM_UP(lcdi2c_gDescriptor);
-    return count;
+    lcdsnapshot(lcd_handler, &snapshot);
+    return snprintf(buf, PAGE_SIZE, "%c", snapshot.cursor ? '1' : '0');
 }
 
 static ssize_t lcdi2c_blink(struct device *dev,
                             struct device_attribute *attr,
                             const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (count > 0) {
-        lcdi2c_gDescriptor->blink = (buf[0] == '1');
-        lcdblink(lcdi2c_gDescriptor, lcdi2c_gDescriptor->blink);
+        lcd_handler->blink = (buf[0] == '1');
+        lcdblink(lcd_handler, lcd_handler->blink);
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_blink_show(struct device *dev,
                                  struct device_attribute *attr, char *buf) {
-    ssize_t count = 0;
-
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
-
-    if (buf)
-        count = snprintf(buf, PAGE_SIZE, "%c", lcdi2c_gDescriptor->blink ? '1' : '0');
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSnapshot_t snapshot;
 
-    SEM_UP(lcdi2c_gDescriptor);
-    return count;
+    lcdsnapshot(lcd_handler, &snapshot);
+    return snprintf(buf, PAGE_SIZE, "%c", snapshot.blink ? '1' : '0');
 }
 
 static ssize_t lcdi2c_home(struct device *dev, struct device_attribute *attr,
                            const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (count > 0 && buf[0] == '1')
-        lcdhome(lcdi2c_gDescriptor);
+        lcdhome(lcd_handler);
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_clear(struct device *dev, struct device_attribute *attr,
                             const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (count > 0 && buf[0] == '1')
-        lcdclear(lcdi2c_gDescriptor);
+        lcdclear(lcd_handler);
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_scrollhz(struct device *dev, struct device_attribute *attr,
                                const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (count > 0)
-        lcdscrollhoriz(lcdi2c_gDescriptor, buf[0] - '0');
+        lcdscrollhoriz(lcd_handler, buf[0] - '0');
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_customchar(struct device *dev,
                                  struct device_attribute *attr,
                                  const char *buf, size_t count) {
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if ((count > 0 && (count % 9)) || count == 0) {
         dev_err(dev, "incomplete character bitmap definition\n");
-        SEM_UP(lcdi2c_gDescriptor);
+        SEM_UP(lcd_handler);
         return -ETOOSMALL;
     }
 
     for (int i = 0; i < count; i += 9) {
         if (buf[i] > 7) {
             dev_err(dev, "%d is out of range, valid range is 0-7\n", buf[i]);
-            SEM_UP(lcdi2c_gDescriptor);
+            SEM_UP(lcd_handler);
             return -ETOOSMALL;
         }
-        lcdcustomchar(lcdi2c_gDescriptor, buf[i], buf + i + 1);
+        lcdcustomchar(lcd_handler, buf[i], buf + i + 1);
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return count;
 }
 
 static ssize_t lcdi2c_customchar_show(struct device *dev,
                                       struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSnapshot_t snapshot;
     ssize_t count = 0;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
-
+    lcdsnapshot(lcd_handler, &snapshot);
     for (int c = 0; c < 8; c++) {
         buf[c * 9] = c;
         count++;
         for (int i = 0; i < 8; i++) {
-            buf[c * 9 + (i + 1)] = lcdi2c_gDescriptor->custom_chars[c][i];
+            buf[c * 9 + (i + 1)] = snapshot.custom_chars[c][i];
             count++;
         }
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
     return count;
 }
 
 static ssize_t lcdi2c_char(struct device *dev,
                            struct device_attribute *attr,
                            const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
     u8 lcd_mem_addr;
 
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
+    if (SEM_DOWN(lcd_handler)) {
         return -ERESTARTSYS;
     }
 
     if (buf && count > 0) {
-        lcd_mem_addr = (1 + lcdi2c_gDescriptor->column + (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns)) % LCD_BUFFER_SIZE;
-        lcdwrite(lcdi2c_gDescriptor, buf[0]);
-        lcdi2c_gDescriptor->column = (lcd_mem_addr % lcdi2c_gDescriptor->organization.columns);
-        lcdi2c_gDescriptor->row = (lcd_mem_addr / lcdi2c_gDescriptor->organization.columns);
-        lcdsetcursor(lcdi2c_gDescriptor, lcdi2c_gDescriptor->column, lcdi2c_gDescriptor->row);
+        lcd_mem_addr = (1 + lcd_handler->column + (lcd_handler->row * lcd_handler->organization.columns)) % LCD_BUFFER_SIZE;
+        lcdwrite(lcd_handler, buf[0]);
+        lcd_handler->column = (lcd_mem_addr % lcd_handler->organization.columns);
+        lcd_handler->row = (lcd_mem_addr / lcd_handler->organization.columns);
+        lcdsetcursor(lcd_handler, lcd_handler->column, lcd_handler->row);
     }
 
-    SEM_UP(lcdi2c_gDescriptor);
+    SEM_UP(lcd_handler);
     return 1;
 }
 
 static ssize_t lcdi2c_char_show(struct device *dev,
                                 struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSnapshot_t snapshot;
     u8 lcd_mem_addr;
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
 
-    lcd_mem_addr = (lcdi2c_gDescriptor->column + (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns))
+    lcdsnapshot(lcd_handler, &snapshot);
+    lcd_mem_addr = (snapshot.column + (snapshot.row * lcd_handler->organization.columns))
                       % LCD_BUFFER_SIZE;
-    buf[0] = lcdi2c_gDescriptor->raw_data[lcd_mem_addr];
+    buf[0] = snapshot.raw_data[lcd_mem_addr];
 
-    SEM_UP(lcdi2c_gDescriptor);
     return 1;
 }
 
 
 static ssize_t lcdi2c_line_show(struct device *dev,
                                 struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSnapshot_t snapshot;
     u8 lcd_mem_addr;
-    ssize_t count = 0;
-
-    if (SEM_DOWN(lcdi2c_gDescriptor)) {
-        return -ERESTARTSYS;
-    }
 
-    lcd_mem_addr = (lcdi2c_gDescriptor->row * lcdi2c_gDescriptor->organization.columns) % LCD_BUFFER_SIZE;
-    for (int i = 0; i < lcdi2c_gDescriptor->organization.columns; i++) {
-        buf[i] = lcdi2c_gDescriptor->raw_data[lcd_mem_addr + i];
-        count++;
-    }
+    lcdsnapshot(lcd_handler, &snapshot);
+    lcd_mem_addr = (snapshot.row * lcd_handler->organization.columns) % LCD_BUFFER_SIZE;
+    memcpy(buf, snapshot.raw_data + lcd_mem_addr, lcd_handler->organization.columns);
 
-    SEM_UP(lcdi2c_gDescriptor);
-    return count;
+    return lcd_handler->organization.columns;
 }
 
 static ssize_t lcdi2c_scrollvert(struct device *dev,
                                    struct device_attribute *attr,
                                    const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
 
     if (count > 0) {
-        if (SEM_DOWN(lcdi2c_gDescriptor)) {
+        if (SEM_DOWN(lcd_handler)) {
             return -ERESTARTSYS;
         }
-        for (uint row = 1; row < lcdi2c_gDescriptor->organization.rows; row++) {
-            memcpy(lcdi2c_gDescriptor->raw_data + ((row - 1) * lcdi2c_gDescriptor->organization.columns),
-                   lcdi2c_gDescriptor->raw_data + (row * lcdi2c_gDescriptor->organization.columns),
-                   lcdi2c_gDescriptor->organization.columns);
-        }
-        memset(lcdi2c_gDescriptor->raw_data + (lcdi2c_gDescriptor->organization.rows - 1) * lcdi2c_gDescriptor->organization.columns,
-               ' ', lcdi2c_gDescriptor->organization.columns);
-        lcdflushbuffer(lcdi2c_gDescriptor);
-        SEM_UP(lcdi2c_gDescriptor);
+        lcdscrollbuffer(lcd_handler, "", 0, 0);
+        lcdi2c_flush(lcd_handler);
+        SEM_UP(lcd_handler);
+    }
+    return count;
+}
+
+static ssize_t lcdi2c_writeback(struct device *dev,
+                                struct device_attribute *attr,
+                                const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+
+    if (count > 0)
+        lcd_handler->driver_data.writeback = (buf[0] == '1');
+
+    SEM_UP(lcd_handler);
+
+    if (!lcd_handler->driver_data.writeback)
+        lcdi2c_sync(lcd_handler);
+    return count;
+}
+
+static ssize_t lcdi2c_writeback_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    return snprintf(buf, PAGE_SIZE, "%c", lcd_handler->driver_data.writeback ? '1' : '0');
+}
+
+static ssize_t lcdi2c_charset(struct device *dev,
+                              struct device_attribute *attr,
+                              const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    int mode = lcdcharset_parse(buf);
+
+    if (mode < 0) {
+        dev_err(dev, "Charset has to be one of: raw, a00, a02\n");
+        return mode;
+    }
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+    lcdcharset_set(&lcd_handler->charset, mode);
+    SEM_UP(lcd_handler);
+
+    return count;
+}
+
+static ssize_t lcdi2c_charset_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    return snprintf(buf, PAGE_SIZE, "%s", charsetnames[lcd_handler->charset.mode]);
+}
+
+static ssize_t lcdi2c_terminal(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+
+    if (count == 0 || (buf[0] != '0' && buf[0] != '1'))
+        return -EINVAL;
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+    lcdterm_reset(&lcd_handler->term);
+    lcd_handler->term.enabled = buf[0] == '1';
+    SEM_UP(lcd_handler);
+
+    return count;
+}
+
+static ssize_t lcdi2c_terminal_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    return snprintf(buf, PAGE_SIZE, "%c", lcd_handler->term.enabled ? '1' : '0');
+}
+
+static ssize_t lcdi2c_framerate(struct device *dev,
+                                struct device_attribute *attr,
+                                const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    uint res;
+    int er;
+
+    er = kstrtouint(buf, 10, &res);
+    if (er == 0 && res >= 1 && res <= LCD_MAX_FRAMERATE) {
+        lcd_handler->driver_data.framerate = res;
+        er = count;
+    } else {
+        dev_err(dev, "Frame rate has to be a number in range 1-%d\n", LCD_MAX_FRAMERATE);
+        er = -EINVAL;
+    }
+
+    return er;
+}
+
+static ssize_t lcdi2c_framerate_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    return snprintf(buf, PAGE_SIZE, "%u", lcd_handler->driver_data.framerate);
+}
+
+static ssize_t lcdi2c_busyflag(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+
+    if (count > 0) {
+        lcd_handler->busy_flag = (buf[0] == '1');
+        lcd_handler->busy_poll = 0;
+        if (lcd_handler->busy_flag)
+            lcdbusyprobe(lcd_handler);
+    }
+
+    SEM_UP(lcd_handler);
+    return count;
+}
+
+static ssize_t lcdi2c_busyflag_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    return snprintf(buf, PAGE_SIZE, "%c", lcd_handler->busy_poll ? '1' : '0');
+}
+
+static ssize_t lcdi2c_calibrate(struct device *dev, struct device_attribute *attr,
+                                const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    int ret = 0;
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+
+    if (count > 0 && buf[0] == '1') {
+        ret = lcdcalibrate(lcd_handler);
+        if (ret)
+            dev_err(dev, "calibration failed: %d\n", ret);
+        else
+            dev_info(dev, "calibrated, instruction: %uns, clear: %uns\n",
+                     lcd_handler->timing.exec_ns, lcd_handler->timing.clear_ns);
+    }
+
+    SEM_UP(lcd_handler);
+    return ret ? ret : count;
+}
+
+static ssize_t lcdi2c_timing(struct device *dev, struct device_attribute *attr,
+                             const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    u32 exec_ns, clear_ns;
+
+    if (sscanf(buf, "%u %u", &exec_ns, &clear_ns) != 2 ||
+        exec_ns < LCD_EXEC_MIN_NS || exec_ns > LCD_EXEC_NS * 4 ||
+        clear_ns < LCD_CLEAR_MIN_NS || clear_ns > LCD_CLEAR_NS * 4) {
+        dev_err(dev, "expected \"<instruction ns> <clear ns>\", at least %ld and %ld, at most 4 times the default\n",
+                LCD_EXEC_MIN_NS, LCD_CLEAR_MIN_NS);
+        return -EINVAL;
+    }
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+
+    lcd_handler->timing.exec_ns = exec_ns;
+    lcd_handler->timing.clear_ns = clear_ns;
+
+    SEM_UP(lcd_handler);
+    return count;
+}
+
+static ssize_t lcdi2c_timing_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    return snprintf(buf, PAGE_SIZE, "%u %u", lcd_handler->timing.exec_ns,
+                    lcd_handler->timing.clear_ns);
+}
+
+static ssize_t lcdi2c_priority(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    u8 res;
+
+    if (kstrtou8(buf, 10, &res) || res > LCD_SCHED_MAX_PRIORITY) {
+        dev_err(dev, "Priority has to be a number in range 0-%d\n", LCD_SCHED_MAX_PRIORITY);
+        return -EINVAL;
+    }
+
+    WRITE_ONCE(lcd_handler->sched.priority, res);
+    return count;
+}
+
+static ssize_t lcdi2c_priority_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    return snprintf(buf, PAGE_SIZE, "%u", lcd_handler->sched.priority);
+}
+
+static ssize_t lcdi2c_busstats_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf) {
+    LcdDescriptor_t *lcd_handler = dev_get_drvdata(dev);
+    LcdSchedClient_t *sched = &lcd_handler->sched;
+    ssize_t ret;
+
+    //counters are updated by bus transfers under the semaphore, 64-bit reads could tear without it
+    if (SEM_DOWN(lcd_handler)) {
+        return -ERESTARTSYS;
+    }
+    ret = snprintf(buf, PAGE_SIZE,
+                   "grants: %llu\n"
+                   "bytes: %llu\n"
+                   "wait-avg-us: %llu\n"
+                   "wait-max-us: %llu\n"
+                   "busy-us: %llu\n"
+                   "share: %u%%\n",
+                   sched->grants, sched->bytes,
+                   sched->grants ? div64_u64(sched->wait_ns, sched->grants) / NSEC_PER_USEC : 0,
+                   sched->wait_max_ns / NSEC_PER_USEC,
+                   sched->busy_ns / NSEC_PER_USEC,
+                   lcdsched_share(sched));
+    SEM_UP(lcd_handler);
+
+    return ret;
+}
+
+/*
+ * Counters of the display in debugfs, one "name: value" per line
+ */
+static int lcdi2c_stats_show(struct seq_file *m, void *v) {
+    LcdDescriptor_t *lcd_handler = m->private;
+    LcdStats_t *stats = &lcd_handler->stats;
+
+    seq_printf(m, "transactions: %llu\n", stats->transactions);
+    seq_printf(m, "bytes: %llu\n", stats->bytes);
+    seq_printf(m, "failures: %llu\n", stats->failures);
+    seq_printf(m, "flushes: %llu\n", stats->flushes);
+    seq_printf(m, "cells: %llu\n", stats->cells);
+    seq_printf(m, "cgram-uploads: %llu\n", stats->cgram_uploads);
+    seq_printf(m, "bus-us: %llu\n", div_u64(stats->bus_ns, NSEC_PER_USEC));
+    seq_printf(m, "delays: %llu\n", stats->delays);
+    seq_printf(m, "delay-us: %llu\n", div_u64(stats->delay_ns, NSEC_PER_USEC));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lcdi2c_stats);
+
+/*
+ * Latency histogram in debugfs, count, sum and maximum, then one line per
+ * log2 bucket, "from-to: count", bounds in microseconds
+ */
+static int lcdi2c_latency_show(struct seq_file *m, void *v) {
+    LcdHistogram_t hist;
+    int i;
+
+    lcdstats_snapshot(m->private, &hist);
+    seq_printf(m, "count: %llu\n", hist.count);
+    seq_printf(m, "sum-us: %llu\n", div_u64(hist.sum_ns, NSEC_PER_USEC));
+    seq_printf(m, "max-us: %llu\n", div_u64(hist.max_ns, NSEC_PER_USEC));
+    for (i = 0; i < LCD_STATS_BUCKETS - 1; i++)
+        seq_printf(m, "%llu-%llu: %llu\n", i ? 1ULL << (i - 1) : 0, 1ULL << i, hist.buckets[i]);
+    seq_printf(m, "%llu-inf: %llu\n", 1ULL << (LCD_STATS_BUCKETS - 2), hist.buckets[LCD_STATS_BUCKETS - 1]);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lcdi2c_latency);
+
+/*
+ * Writing 1 to debugfs "reset" zeroes counters and histograms of the display
+ */
+static ssize_t lcdi2c_stats_reset(struct file *file, const char __user *buffer,
+                                  size_t count, loff_t *offset) {
+    LcdDescriptor_t *lcd_handler = file->private_data;
+    char value;
+
+    if (!count || copy_from_user(&value, buffer, 1))
+        return -EIO;
+    if (value != '1')
+        return -EINVAL;
+
+    if (SEM_DOWN(lcd_handler)) {
+        return -EBUSY;
     }
+    lcdstats_reset(&lcd_handler->stats);
+    SEM_UP(lcd_handler);
+
     return count;
 }
 
+static const struct file_operations lcdi2c_stats_reset_fops = {
+        .open = simple_open,
+        .write = lcdi2c_stats_reset,
+        .llseek = noop_llseek,
+        .owner = THIS_MODULE,
+};
+
+/*
+ * Creates lcdi2c/<device name>/ in debugfs. Errors are ignored, display
+ * works the same without its statistics.
+ */
+static void lcdi2c_debugfs_create(LcdDescriptor_t *lcd_handler) {
+    struct dentry *dir = debugfs_create_dir(dev_name(lcd_handler->driver_data.lcdi2c_device), lcdi2c_debugfs);
+
+    lcd_handler->driver_data.debugfs = dir;
+    debugfs_create_file("stats", S_IRUSR, dir, lcd_handler, &lcdi2c_stats_fops);
+    debugfs_create_file("flush-latency", S_IRUSR, dir, &lcd_handler->stats.flush, &lcdi2c_latency_fops);
+    debugfs_create_file("ioctl-latency", S_IRUSR, dir, &lcd_handler->stats.ioctl, &lcdi2c_latency_fops);
+    debugfs_create_file("lock-wait", S_IRUSR, dir, &lcd_handler->stats.lock_wait, &lcdi2c_latency_fops);
+    debugfs_create_file("reset", S_IWUSR, dir, lcd_handler, &lcdi2c_stats_reset_fops);
+}
+
+/*
+ * All displays share one class and one major number, each probed display
+ * takes a minor from the range reserved here
+ */
+static int __init lcdi2c_init(void) {
+    int ret;
+
+    ret = alloc_chrdev_region(&lcdi2c_devt, 0, LCDI2C_MAX_DEVICES, DEVICE_NAME);
+    if (ret < 0) {
+        pr_err("lcdi2c: failed to allocate major number\n");
+        return ret;
+    }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    lcdi2c_class = class_create(DEVICE_CLASS_NAME);
+#else
+    lcdi2c_class = class_create(THIS_MODULE, DEVICE_CLASS_NAME);
+#endif
+    if (IS_ERR(lcdi2c_class)) {
+        pr_err("lcdi2c: class creation failed %s\n", DEVICE_CLASS_NAME);
+        ret = PTR_ERR(lcdi2c_class);
+        goto classError;
+    }
+    lcdi2c_class->dev_uevent = lcdi2c_dev_uevent;
+    lcdi2c_debugfs = debugfs_create_dir(DEVICE_NAME, NULL);
+
+    ret = i2c_add_driver(&lcdi2c_driver);
+    if (ret)
+        goto driverError;
+
+    return 0;
+
+driverError:
+    debugfs_remove_recursive(lcdi2c_debugfs);
+    class_destroy(lcdi2c_class);
+classError:
+    unregister_chrdev_region(lcdi2c_devt, LCDI2C_MAX_DEVICES);
+    return ret;
+}
+
+static void __exit lcdi2c_exit(void) {
+    i2c_del_driver(&lcdi2c_driver);
+    debugfs_remove_recursive(lcdi2c_debugfs);
+    class_destroy(lcdi2c_class);
+    unregister_chrdev_region(lcdi2c_devt, LCDI2C_MAX_DEVICES);
+    ida_destroy(&lcdi2c_minors);
+}
 
-module_i2c_driver(lcdi2c_driver);
+module_init(lcdi2c_init);
+module_exit(lcdi2c_exit);
 
 
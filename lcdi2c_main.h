@@ -10,6 +10,9 @@
 #include <linux/fs.h>
 #include <linux/ioctl.h>
 #include <linux/cdev.h>
+#include <linux/idr.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
 #include <linux/device.h>
 #include <asm/uaccess.h>
 #include <linux/ioctl.h>
@@ -17,6 +20,7 @@
 #include <linux/types.h>	/* size_t */
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/debugfs.h>
 #include <linux/fcntl.h>	/* O_ACCMODE */
 #include <linux/aio.h>
 #include <linux/version.h>
@@ -31,11 +35,13 @@
 #define WS_MAX_LEN (16)
 #define DEFAULT_WS "HDD44780\nDriver"
 #define META_BUFFER_LEN (100)
+#define LCD_TERM_CHUNK (256)    //terminal mode write() is interpreted in chunks of this size
 #define SHORT_STR_LEN (12)
 #define SUCCESS (0)
 
 #define DEVICE_NAME "lcdi2c"
 #define DEVICE_MAJOR (0)
+#define LCDI2C_MAX_DEVICES (16)
 #define DEVICE_CLASS_NAME "alphalcd"
 
 // According to https://www.kernel.org/doc/html/latest/userspace-api/ioctl/ioctl-number.html this code is free
@@ -65,17 +71,63 @@
 #define LCD_IOCTL_CLEAR _IO(LCD_IOCTL_BASE, IOCTLC | (0x13 << 2))
 #define LCD_IOCTL_RESET _IO(LCD_IOCTL_BASE, IOCTLC | (0x14 << 2))
 #define LCD_IOCTL_HOME  _IO(LCD_IOCTL_BASE, IOCTLC | (0x15 << 2))
+#define LCD_IOCTL_SYNC  _IO(LCD_IOCTL_BASE, IOCTLC | (0x16 << 2))
+#define LCD_IOCTL_COMMIT _IOW(LCD_IOCTL_BASE, IOCTLB | (0x17 << 2), LcdCommitArgs_t)
+#define LCD_IOCTL_BATCH _IOWR(LCD_IOCTL_BASE, IOCTLB | (0x18 << 2), LcdBatchArgs_t)
+#define LCD_IOCTL_GETSTATE _IOR(LCD_IOCTL_BASE, IOCTLB | (0x19 << 2), LcdSnapshot_t)
+#define LCD_IOCTL_SETGLYPH _IOWR(LCD_IOCTL_BASE, IOCTLB | (0x1A << 2), LcdGlyphArgs_t)
+#define LCD_IOCTL_ANIMATE _IOW(LCD_IOCTL_BASE, IOCTLB | (0x1B << 2), LcdAnimationArgs_t)
+#define LCD_IOCTL_MARQUEE _IOW(LCD_IOCTL_BASE, IOCTLB | (0x1C << 2), LcdMarqueeArgs_t)
+#define LCD_IOCTL_SETPAGE _IOW(LCD_IOCTL_BASE, IOCTLB | (0x1D << 2), LcdBuffer_t)
+#define LCD_IOCTL_FLIP  _IO(LCD_IOCTL_BASE, IOCTLC | (0x1E << 2))
+#define LCD_IOCTL_SETWINDOW _IOW(LCD_IOCTL_BASE, IOCTLB | (0x1F << 2), LcdWindowArgs_t)
 
-#define SEM_DOWN(lcd_handler) down_interruptible(&lcd_handler->driver_data.sem)
-#define SEM_UP(lcd_handler) up(&lcd_handler->driver_data.sem)
+//Waits for the semaphore interruptibly, time spent waiting is traced
+#define SEM_DOWN(lcd_handler) lcdi2c_sem_down(lcd_handler)
+//Changes are published for lock-free readers when writer releases the semaphore
+#define SEM_UP(lcd_handler) do { lcdpublish(lcd_handler); up(&lcd_handler->driver_data.sem); } while (0)
+
+//Per open file state, generation is the content reader has seen last. Window is the region
+//claimed by SETWINDOW, column and row are the cursor of the file within it
+typedef struct lcdi2c_file {
+    LcdDescriptor_t *lcd;
+    u64 generation;
+    LcdWindowArgs_t window;
+    u8 column;
+    u8 row;
+} LcdFile_t;
+
+#define FILE_LCD(file) (((LcdFile_t *) (file)->private_data)->lcd)
+#define FILE_GONE(file) READ_ONCE(FILE_LCD(file)->driver_data.gone)
+#define FILE_WINDOWED(lcd_file) ((lcd_file)->window.columns != 0)
+
+/*
+  Sysfs attribute whose accesses are traced, show and store of the device attribute are
+  generic wrappers which trace the call of the handlers kept here
+*/
+typedef struct lcdi2c_attribute {
+    struct device_attribute attr;
+    ssize_t (*show)(struct device *dev, struct device_attribute *attr, char *buf);
+    ssize_t (*store)(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+} Lcdi2cAttribute_t;
+
+#define LCDI2C_ATTR(_name, _mode, _show, _store) \
+    static Lcdi2cAttribute_t dev_attr_##_name = { \
+        .attr = __ATTR(_name, _mode, lcdi2c_attr_show, lcdi2c_attr_store), \
+        .show = _show, \
+        .store = _store, \
+    }
 
 typedef struct ioctl_description {
   const uint32_t ioctl_code;
   const char name[24];
 } IOCTLDescription_t;
 
+static int lcdi2c_sem_down(LcdDescriptor_t *lcd_handler);
 static int lcdi2c_register(struct i2c_client *client);
 static void lcdi2c_unregister(struct i2c_client *client);
+static void lcdi2c_free(struct kref *ref);
+static void lcdi2c_debugfs_create(LcdDescriptor_t *lcd_handler);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
 static int lcdi2c_probe(struct i2c_client *client);
 #else
@@ -89,7 +141,21 @@ loff_t lcdi2c_lseek(struct file *file, loff_t offset, int orig);
 static long lcdi2c_ioctl(struct file *file, unsigned int ioctl_num, unsigned long arg);
 static int lcdi2c_open(struct inode *inode, struct file *file);
 static int lcdi2c_release(struct inode *inode, struct file *file);
+static int lcdi2c_fsync(struct file *file, loff_t start, loff_t end, int datasync);
+static int lcdi2c_mmap(struct file *file, struct vm_area_struct *vma);
+static __poll_t lcdi2c_poll(struct file *file, poll_table *wait);
+static ssize_t lcdi2c_traced_read(struct file *file, char __user *buffer, size_t length, loff_t *offset);
+static ssize_t lcdi2c_traced_write(struct file *file, const char __user *buffer, size_t length, loff_t *offset);
+static loff_t lcdi2c_traced_lseek(struct file *file, loff_t offset, int orig);
+static long lcdi2c_traced_ioctl(struct file *file, unsigned int ioctl_num, unsigned long arg);
+static int lcdi2c_traced_open(struct inode *inode, struct file *file);
+static int lcdi2c_traced_release(struct inode *inode, struct file *file);
+static int lcdi2c_traced_fsync(struct file *file, loff_t start, loff_t end, int datasync);
+static int lcdi2c_traced_mmap(struct file *file, struct vm_area_struct *vma);
+static __poll_t lcdi2c_traced_poll(struct file *file, poll_table *wait);
 
+static ssize_t lcdi2c_attr_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_attr_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
 static ssize_t lcdi2c_reset(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
 static ssize_t lcdi2c_backlight_show(struct device *dev, struct device_attribute *attr, char *buf);
 static ssize_t lcdi2c_backlight(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
@@ -111,37 +177,71 @@ static ssize_t lcdi2c_customchar(struct device *dev, struct device_attribute *at
 static ssize_t lcdi2c_char_show(struct device *dev, struct device_attribute *attr, char *buf);
 static ssize_t lcdi2c_char(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
 static ssize_t lcdi2c_line_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_writeback_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_writeback(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+static ssize_t lcdi2c_framerate_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_framerate(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+static ssize_t lcdi2c_busyflag_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_busyflag(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+static ssize_t lcdi2c_calibrate(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+static ssize_t lcdi2c_timing_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_timing(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+static ssize_t lcdi2c_priority_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_priority(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+static ssize_t lcdi2c_busstats_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_charset_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_charset(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+static ssize_t lcdi2c_terminal_show(struct device *dev, struct device_attribute *attr, char *buf);
+static ssize_t lcdi2c_terminal(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
 
-DEVICE_ATTR(reset, S_IWUSR | S_IWGRP, NULL, lcdi2c_reset);
-DEVICE_ATTR(brightness, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_backlight_show, lcdi2c_backlight);
-DEVICE_ATTR(position, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_cursorpos_show, lcdi2c_cursorpos);
-DEVICE_ATTR(data, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_data_show, lcdi2c_data);
-DEVICE_ATTR(meta, S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_meta_show, NULL);
-DEVICE_ATTR(cursor, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_cursor_show, lcdi2c_cursor);
-DEVICE_ATTR(blink, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_blink_show, lcdi2c_blink);
-DEVICE_ATTR(home, S_IWUSR | S_IWGRP, NULL, lcdi2c_home);
-DEVICE_ATTR(clear, S_IWUSR | S_IWGRP, NULL, lcdi2c_clear);
-DEVICE_ATTR(scrollhz, S_IWUSR | S_IWGRP, NULL, lcdi2c_scrollhz);
-DEVICE_ATTR(scrollvert, S_IWUSR | S_IWGRP, NULL, lcdi2c_scrollvert);
-DEVICE_ATTR(customchar, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_customchar_show, lcdi2c_customchar);
-DEVICE_ATTR(character, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_char_show, lcdi2c_char);
-DEVICE_ATTR(line, S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_line_show, NULL);
+LCDI2C_ATTR(reset, S_IWUSR | S_IWGRP, NULL, lcdi2c_reset);
+LCDI2C_ATTR(brightness, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_backlight_show, lcdi2c_backlight);
+LCDI2C_ATTR(position, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_cursorpos_show, lcdi2c_cursorpos);
+LCDI2C_ATTR(data, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_data_show, lcdi2c_data);
+LCDI2C_ATTR(meta, S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_meta_show, NULL);
+LCDI2C_ATTR(cursor, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_cursor_show, lcdi2c_cursor);
+LCDI2C_ATTR(blink, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_blink_show, lcdi2c_blink);
+LCDI2C_ATTR(home, S_IWUSR | S_IWGRP, NULL, lcdi2c_home);
+LCDI2C_ATTR(clear, S_IWUSR | S_IWGRP, NULL, lcdi2c_clear);
+LCDI2C_ATTR(scrollhz, S_IWUSR | S_IWGRP, NULL, lcdi2c_scrollhz);
+LCDI2C_ATTR(scrollvert, S_IWUSR | S_IWGRP, NULL, lcdi2c_scrollvert);
+LCDI2C_ATTR(customchar, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_customchar_show, lcdi2c_customchar);
+LCDI2C_ATTR(character, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_char_show, lcdi2c_char);
+LCDI2C_ATTR(line, S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_line_show, NULL);
+LCDI2C_ATTR(writeback, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_writeback_show, lcdi2c_writeback);
+LCDI2C_ATTR(framerate, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_framerate_show, lcdi2c_framerate);
+LCDI2C_ATTR(busyflag, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_busyflag_show, lcdi2c_busyflag);
+LCDI2C_ATTR(calibrate, S_IWUSR | S_IWGRP, NULL, lcdi2c_calibrate);
+LCDI2C_ATTR(timing, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_timing_show, lcdi2c_timing);
+LCDI2C_ATTR(priority, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_priority_show, lcdi2c_priority);
+LCDI2C_ATTR(busstats, S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_busstats_show, NULL);
+LCDI2C_ATTR(charset, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_charset_show, lcdi2c_charset);
+LCDI2C_ATTR(terminal, S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP | S_IROTH, lcdi2c_terminal_show, lcdi2c_terminal);
 
 static const struct attribute *i2clcd_attrs[] = {
-        &dev_attr_reset.attr,
-        &dev_attr_brightness.attr,
-        &dev_attr_position.attr,
-        &dev_attr_data.attr,
-        &dev_attr_meta.attr,
-        &dev_attr_cursor.attr,
-        &dev_attr_blink.attr,
-        &dev_attr_home.attr,
-        &dev_attr_clear.attr,
-        &dev_attr_scrollhz.attr,
-        &dev_attr_scrollvert.attr,
-        &dev_attr_customchar.attr,
-        &dev_attr_character.attr,
-        &dev_attr_line.attr,
+        &dev_attr_reset.attr.attr,
+        &dev_attr_brightness.attr.attr,
+        &dev_attr_position.attr.attr,
+        &dev_attr_data.attr.attr,
+        &dev_attr_meta.attr.attr,
+        &dev_attr_cursor.attr.attr,
+        &dev_attr_blink.attr.attr,
+        &dev_attr_home.attr.attr,
+        &dev_attr_clear.attr.attr,
+        &dev_attr_scrollhz.attr.attr,
+        &dev_attr_scrollvert.attr.attr,
+        &dev_attr_customchar.attr.attr,
+        &dev_attr_character.attr.attr,
+        &dev_attr_line.attr.attr,
+        &dev_attr_writeback.attr.attr,
+        &dev_attr_framerate.attr.attr,
+        &dev_attr_busyflag.attr.attr,
+        &dev_attr_calibrate.attr.attr,
+        &dev_attr_timing.attr.attr,
+        &dev_attr_priority.attr.attr,
+        &dev_attr_busstats.attr.attr,
+        &dev_attr_charset.attr.attr,
+        &dev_attr_terminal.attr.attr,
         NULL,
 };
 
@@ -0,0 +1,175 @@
+//
+// Tracepoints of the driver: operations, semaphore waits, flushes and bus transfers
+//
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lcdi2c
+
+#ifndef LCDI2C_TRACE_DEFS
+#define LCDI2C_TRACE_DEFS
+
+//Kinds of traced operations
+#define LCDI2C_OP_FOP (0)           //file operation, name is the call
+#define LCDI2C_OP_IOCTL (1)         //ioctl, code is its number
+#define LCDI2C_OP_SHOW (2)          //sysfs attribute read, name is the attribute
+#define LCDI2C_OP_STORE (3)         //sysfs attribute write
+#define LCDI2C_TRACE_NAME_LEN (16)
+
+#endif //LCDI2C_TRACE_DEFS
+
+#if !defined(LCDI2C_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LCDI2C_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#include "lcdlib.h"
+
+#define LCDI2C_TRACE_DISPLAY(lcd) \
+    __entry->bus = (lcd)->driver_data.client->adapter->nr; \
+    __entry->addr = (lcd)->driver_data.client->addr
+
+#define LCDI2C_TRACE_OPS \
+    __print_symbolic(__entry->kind, {LCDI2C_OP_FOP, "fop"}, {LCDI2C_OP_IOCTL, "ioctl"}, \
+                     {LCDI2C_OP_SHOW, "show"}, {LCDI2C_OP_STORE, "store"})
+
+/*
+  Entry to an operation of a display, task doing it is recorded by the tracer
+*/
+TRACE_EVENT(lcdi2c_op_start,
+    TP_PROTO(LcdDescriptor_t *lcd, u8 kind, unsigned int code, const char *name),
+    TP_ARGS(lcd, kind, code, name),
+    TP_STRUCT__entry(
+        __field(int, bus)
+        __field(u16, addr)
+        __field(u8, kind)
+        __field(unsigned int, code)
+        __array(char, name, LCDI2C_TRACE_NAME_LEN)
+    ),
+    TP_fast_assign(
+        LCDI2C_TRACE_DISPLAY(lcd);
+        __entry->kind = kind;
+        __entry->code = code;
+        strscpy(__entry->name, name, LCDI2C_TRACE_NAME_LEN);
+    ),
+    TP_printk("lcd=%d-%02x %s %s code=0x%08x", __entry->bus, __entry->addr,
+              LCDI2C_TRACE_OPS, __entry->name, __entry->code)
+);
+
+/*
+  Return from an operation, with its return value
+*/
+TRACE_EVENT(lcdi2c_op_end,
+    TP_PROTO(LcdDescriptor_t *lcd, u8 kind, unsigned int code, const char *name, long ret),
+    TP_ARGS(lcd, kind, code, name, ret),
+    TP_STRUCT__entry(
+        __field(int, bus)
+        __field(u16, addr)
+        __field(u8, kind)
+        __field(unsigned int, code)
+        __array(char, name, LCDI2C_TRACE_NAME_LEN)
+        __field(long, ret)
+    ),
+    TP_fast_assign(
+        LCDI2C_TRACE_DISPLAY(lcd);
+        __entry->kind = kind;
+        __entry->code = code;
+        strscpy(__entry->name, name, LCDI2C_TRACE_NAME_LEN);
+        __entry->ret = ret;
+    ),
+    TP_printk("lcd=%d-%02x %s %s code=0x%08x ret=%ld", __entry->bus, __entry->addr,
+              LCDI2C_TRACE_OPS, __entry->name, __entry->code, __entry->ret)
+);
+
+/*
+  Time an operation waited for the display semaphore, ret is non-zero if the wait
+  was interrupted
+*/
+TRACE_EVENT(lcdi2c_sem_wait,
+    TP_PROTO(LcdDescriptor_t *lcd, u64 wait_ns, int ret),
+    TP_ARGS(lcd, wait_ns, ret),
+    TP_STRUCT__entry(
+        __field(int, bus)
+        __field(u16, addr)
+        __field(u64, wait_ns)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        LCDI2C_TRACE_DISPLAY(lcd);
+        __entry->wait_ns = wait_ns;
+        __entry->ret = ret;
+    ),
+    TP_printk("lcd=%d-%02x wait_ns=%llu ret=%d", __entry->bus, __entry->addr,
+              __entry->wait_ns, __entry->ret)
+);
+
+/*
+  Flush of the screen buffer, or of the back page, with data and instruction bytes
+  it took and time from start to the last transfer
+*/
+TRACE_EVENT(lcdi2c_flush,
+    TP_PROTO(LcdDescriptor_t *lcd, u8 page, u32 cells, u32 commands, u64 duration_ns),
+    TP_ARGS(lcd, page, cells, commands, duration_ns),
+    TP_STRUCT__entry(
+        __field(int, bus)
+        __field(u16, addr)
+        __field(u8, page)
+        __field(u32, cells)
+        __field(u32, commands)
+        __field(u64, duration_ns)
+    ),
+    TP_fast_assign(
+        LCDI2C_TRACE_DISPLAY(lcd);
+        __entry->page = page;
+        __entry->cells = cells;
+        __entry->commands = commands;
+        __entry->duration_ns = duration_ns;
+    ),
+    TP_printk("lcd=%d-%02x %s cells=%u commands=%u duration_ns=%llu", __entry->bus, __entry->addr,
+              __entry->page ? "page" : "buffer", __entry->cells, __entry->commands, __entry->duration_ns)
+);
+
+DECLARE_EVENT_CLASS(lcdi2c_bus,
+    TP_PROTO(LcdDescriptor_t *lcd, u16 len, u8 burst, int ret, u64 duration_ns),
+    TP_ARGS(lcd, len, burst, ret, duration_ns),
+    TP_STRUCT__entry(
+        __field(int, bus)
+        __field(u16, addr)
+        __field(u16, len)
+        __field(u8, burst)
+        __field(int, ret)
+        __field(u64, duration_ns)
+    ),
+    TP_fast_assign(
+        LCDI2C_TRACE_DISPLAY(lcd);
+        __entry->len = len;
+        __entry->burst = burst;
+        __entry->ret = ret;
+        __entry->duration_ns = duration_ns;
+    ),
+    TP_printk("lcd=%d-%02x %s len=%u ret=%d duration_ns=%llu", __entry->bus, __entry->addr,
+              __entry->burst ? "i2c" : "smbus", __entry->len, __entry->ret, __entry->duration_ns)
+);
+
+/*
+  Expander bytes pushed to the bus, a burst or a single SMBus byte
+*/
+DEFINE_EVENT(lcdi2c_bus, lcdi2c_bus_write,
+    TP_PROTO(LcdDescriptor_t *lcd, u16 len, u8 burst, int ret, u64 duration_ns),
+    TP_ARGS(lcd, len, burst, ret, duration_ns)
+);
+
+/*
+  Read of the controller through the expander, len is number of bytes moved
+*/
+DEFINE_EVENT(lcdi2c_bus, lcdi2c_bus_read,
+    TP_PROTO(LcdDescriptor_t *lcd, u16 len, u8 burst, int ret, u64 duration_ns),
+    TP_ARGS(lcd, len, burst, ret, duration_ns)
+);
+
+#endif //LCDI2C_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE lcdi2c_trace
+#include <trace/define_trace.h>
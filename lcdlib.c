@@ -5,6 +5,7 @@
 #include <linux/delay.h>
 
 #include "lcdlib.h"
+#include "lcdi2c_trace.h"
 
 /* Pin mapping array */
 uint pinout[8] = {0, 1, 2, 3, 4, 5, 6, 7}; //I2C module pinout configuration in order:
@@ -12,11 +13,204 @@ uint pinout[8] = {0, 1, 2, 3, 4, 5, 6, 7}; //I2C module pinout configuration in
 
 
 void _udelay_(u32 usecs) {
-    udelay(usecs);
+    _ndelay_((u64) usecs * NSEC_PER_USEC);
 }
 
 /**
- * write a byte to i2c device, sets backlight pin
+ * waits given number of nanoseconds, very short waits are spun, anything
+ * longer sleeps, so CPU is free for other tasks while LCD is busy.
+ *
+ * @param u64 number of nanoseconds
+ * @return none
+ *
+ */
+void _ndelay_(u64 nsecs) {
+    u32 usecs = DIV_ROUND_UP(nsecs, NSEC_PER_USEC);
+
+    if (!nsecs)
+        return;
+    if (nsecs < LCD_SPIN_MAX_NS)
+        udelay(usecs);
+    else if (usecs < 20 * USEC_PER_MSEC)
+        usleep_range(usecs, usecs + (usecs >> 2));
+    else
+        MSLEEP(DIV_ROUND_UP(usecs, USEC_PER_MSEC));
+}
+
+/**
+ * takes display's turn on the adapter and in burst mode locks the adapter,
+ * both are kept until the frame ends or another display wants the bus
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _xfer_acquire(LcdDescriptor_t *lcd) {
+    if (lcd->xfer.locked)
+        return;
+    lcdsched_acquire(&lcd->sched);
+    if (lcd->xfer.burst)
+        LOWLEVEL_LOCK(lcd->driver_data.client);
+    lcd->xfer.locked = 1;
+}
+
+/**
+ * unlocks the adapter and lets other displays on it have their turn
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _xfer_release(LcdDescriptor_t *lcd) {
+    if (!lcd->xfer.locked)
+        return;
+    if (lcd->xfer.burst)
+        LOWLEVEL_UNLOCK(lcd->driver_data.client);
+    lcdsched_release(&lcd->sched);
+    lcd->xfer.locked = 0;
+}
+
+/**
+ * push queued bytes of current frame to the bus. In burst mode bytes are sent
+ * as a single I2C write with adapter locked, lock is kept until the frame ends.
+ * Adapters without I2C_FUNC_I2C get a byte by byte SMBus write instead.
+ * If another display on the adapter waits, bus is handed over after
+ * each chunk, so a long frame doesn't starve it.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return int 0 on success, negative error code otherwise
+ *
+ */
+static int _xfer_send(LcdDescriptor_t *lcd) {
+    struct i2c_client *client = lcd->driver_data.client;
+    LcdTransport_t *xfer = &lcd->xfer;
+    struct i2c_msg msg;
+    ktime_t start = 0, now = 0;
+    int ret = 0;
+
+    if (!xfer->length) {
+        //nothing queued, time owed since the last transfer has been running already
+    } else if (xfer->burst) {
+        msg.addr = client->addr;
+        msg.flags = client->flags & I2C_M_TEN;
+        msg.len = xfer->length;
+        msg.buf = xfer->buffer;
+
+        _xfer_acquire(lcd);
+        start = ktime_get();
+        ret = LOWLEVEL_BURST(client, &msg);
+        ret = (ret == 1) ? 0 : (ret < 0 ? ret : -EIO);
+        now = ktime_get();
+        lcd->stats.transactions++;
+        trace_lcdi2c_bus_write(lcd, xfer->length, 1, ret, ktime_to_ns(ktime_sub(now, start)));
+    } else {
+        _xfer_acquire(lcd);
+        start = now = ktime_get();
+        for (u16 i = 0; i < xfer->length && !ret; i++) {
+            ret = LOWLEVEL_WRITE(client, xfer->buffer[i]);
+            lcd->stats.transactions++;
+            if (trace_lcdi2c_bus_write_enabled()) {
+                ktime_t sent = ktime_get();
+
+                trace_lcdi2c_bus_write(lcd, 1, 0, ret, ktime_to_ns(ktime_sub(sent, now)));
+                now = sent;
+            }
+        }
+        now = ktime_get();
+    }
+    lcd->sched.bytes += xfer->length;
+    lcd->stats.bytes += xfer->length;
+    lcd->stats.bus_ns += ktime_to_ns(ktime_sub(now, start));
+
+    if (ret) {
+        xfer->error = ret;
+        lcd->redraw = 1;
+        lcd->cgram_valid = 0;
+        lcd->stats.failures++;
+        dev_err_ratelimited(&client->dev, "bus write of %u bytes failed: %d\n", xfer->length, ret);
+    }
+    xfer->length = 0;
+    if (xfer->owed_ns) {
+        xfer->ready_at = ktime_add_ns(ktime_get(), xfer->owed_ns);
+        xfer->owed_ns = 0;
+    }
+    if (lcdsched_contended(&lcd->sched))
+        _xfer_release(lcd);
+
+    return ret;
+}
+
+/**
+ * send what's left of current frame and release the adapter
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _xfer_flush(LcdDescriptor_t *lcd) {
+    _xfer_send(lcd);
+    _xfer_release(lcd);
+}
+
+/**
+ * opens a frame, frames can be nested, only the outermost one
+ * sends data to the bus when ended
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _xfer_begin(LcdDescriptor_t *lcd) {
+    lcd->xfer.depth++;
+}
+
+/**
+ * closes a frame, when outermost frame is closed all queued
+ * bytes are sent to the bus
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _xfer_end(LcdDescriptor_t *lcd) {
+    if (lcd->xfer.depth && --lcd->xfer.depth)
+        return;
+    _xfer_flush(lcd);
+}
+
+/**
+ * queue bytes for the expander, as they are. Whenever buffer is full, it's
+ * content is pushed to the bus as part of current frame. While other
+ * display on the adapter waits for the bus, chunks are kept short.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8* bytes to send to expander
+ * @param u8 number of bytes
+ * @return none
+ *
+ */
+static void _busqueue(LcdDescriptor_t *lcd, const u8 *data, u8 count) {
+    LcdTransport_t *xfer = &lcd->xfer;
+    u32 bus_ns;
+    u8 n;
+
+    while (count) {
+        if (xfer->length >= xfer->max_length ||
+            (xfer->length >= LCD_SCHED_BURST_BYTES && lcdsched_contended(&lcd->sched)))
+            _xfer_send(lcd);
+        n = min_t(u8, count, xfer->max_length - xfer->length);
+        memcpy(xfer->buffer + xfer->length, data, n);
+        xfer->length += n;
+        xfer->state = data[n - 1];
+        bus_ns = n * xfer->byte_ns;
+        xfer->owed_ns = xfer->owed_ns > bus_ns ? xfer->owed_ns - bus_ns : 0;
+        data += n;
+        count -= n;
+    }
+}
+
+/**
+ * queue a byte for the expander, sets backlight pin
  * on or off depending on current stup in LcdData struture
  * given as parameter.
  *
@@ -27,11 +221,173 @@ void _udelay_(u32 usecs) {
  */
 static void _buswrite(LcdDescriptor_t *lcd, u8 data) {
     data |= lcd->backlight ? (1 << PIN_BACKLIGHT) : 0;
-    LOWLEVEL_WRITE(lcd->driver_data.client, data);
+    _busqueue(lcd, &data, 1);
+}
+
+/**
+ * converts expander port value into a nibble according to pinout
+ *
+ * @param u8 value read from the expander
+ * @return u8 nibble on data lines DB4-DB7
+ *
+ */
+static u8 _portnibble(u8 port) {
+    return ((port >> PIN_DB4) & 1) | (((port >> PIN_DB5) & 1) << 1) |
+           (((port >> PIN_DB6) & 1) << 2) | (((port >> PIN_DB7) & 1) << 3);
+}
+
+/**
+ * reads a byte from the controller. PCF8574 port is quasi-bidirectional, pins
+ * written high are weakly pulled up and can be driven low by the LCD, so data
+ * lines are released, RW set high and the value is sampled while EN is high.
+ * If only high nibble is needed (busy flag), low one is just clocked out.
+ * Queued frame is sent before reading.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 LCD_MODE_COMMAND for busy flag and address, LCD_MODE_DATA for RAM
+ * @param u8* where to store the value
+ * @param u8 read low nibble too
+ * @return int 0 on success, negative error code otherwise
+ *
+ */
+static int _lcdread(LcdDescriptor_t *lcd, u8 mode, u8 *value, u8 both) {
+    struct i2c_client *client = lcd->driver_data.client;
+    u8 idle = (lcd->backlight ? (1 << PIN_BACKLIGHT) : 0) | mode | (1 << PIN_RW) |
+              (1 << PIN_DB4) | (1 << PIN_DB5) | (1 << PIN_DB6) | (1 << PIN_DB7);
+    u8 pulse[3] = {idle, idle | (1 << PIN_EN), idle};
+    u8 port[2] = {0, 0};
+    struct i2c_msg msgs[5];
+    ktime_t start;
+    s64 elapsed;
+    u16 bytes = 0;
+    int ret, num = 0;
+
+    _xfer_flush(lcd);
+    lcdsched_acquire(&lcd->sched);
+    start = ktime_get();
+
+    if (lcd->xfer.burst) {
+        msgs[num++] = (struct i2c_msg) {.addr = client->addr, .flags = 0, .len = 2, .buf = pulse};
+        msgs[num++] = (struct i2c_msg) {.addr = client->addr, .flags = I2C_M_RD, .len = 1, .buf = port};
+        if (both) {
+            msgs[num++] = (struct i2c_msg) {.addr = client->addr, .flags = 0, .len = 2, .buf = pulse};
+            msgs[num++] = (struct i2c_msg) {.addr = client->addr, .flags = I2C_M_RD, .len = 1, .buf = port + 1};
+            msgs[num++] = (struct i2c_msg) {.addr = client->addr, .flags = 0, .len = 1, .buf = pulse};
+        } else {
+            msgs[num++] = (struct i2c_msg) {.addr = client->addr, .flags = 0, .len = 3, .buf = pulse};
+        }
+        ret = LOWLEVEL_TRANSFER(client, msgs, num);
+        ret = (ret == num) ? 0 : (ret < 0 ? ret : -EIO);
+        for (u8 i = 0; i < num; i++)
+            bytes += msgs[i].len;
+        lcd->stats.transactions++;
+    } else {
+        //every SMBus call moves a single byte
+        ret = LOWLEVEL_WRITE(client, pulse[0]);
+        bytes++;
+        for (u8 i = 0; i < 2 && ret >= 0; i++) {
+            ret = LOWLEVEL_WRITE(client, pulse[1]);
+            bytes++;
+            if (ret >= 0 && (i == 0 || both)) {
+                ret = LOWLEVEL_READ(client);
+                port[i] = ret;
+                bytes++;
+            }
+            if (ret >= 0) {
+                ret = LOWLEVEL_WRITE(client, pulse[2]);
+                bytes++;
+            }
+        }
+        ret = ret < 0 ? ret : 0;
+        lcd->stats.transactions += bytes;
+    }
+    elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+    lcd->stats.bytes += bytes;
+    lcd->stats.bus_ns += elapsed;
+    if (ret)
+        lcd->stats.failures++;
+    trace_lcdi2c_bus_read(lcd, bytes, lcd->xfer.burst, ret, elapsed);
+
+    lcdsched_release(&lcd->sched);
+    lcd->xfer.state = idle;
+    if (ret)
+        return ret;
+
+    *value = (_portnibble(port[0]) << 4) | (both ? _portnibble(port[1]) : 0);
+    return 0;
+}
+
+/**
+ * polls busy flag until controller is ready, but no longer than fixed
+ * timing would have waited anyway
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _lcdpoll(LcdDescriptor_t *lcd) {
+    u8 status;
+
+    while (ktime_before(ktime_get(), lcd->xfer.ready_at)) {
+        if (_lcdread(lcd, LCD_MODE_COMMAND, &status, 0))
+            return;
+        if (!(status & LCD_BUSY_FLAG)) {
+            lcd->xfer.ready_at = ktime_get();
+            return;
+        }
+    }
+}
+
+/**
+ * makes sure controller is ready to latch next instruction. Bytes of the
+ * first nibble up to its falling EN edge are on the bus before it's latched,
+ * so execution time of previous instruction shorter than that needs no wait.
+ * Otherwise queued frame is sent, adapter released and we sleep for
+ * whatever is left, or poll busy flag if it's available and wait is
+ * longer than a poll.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _lcdready(LcdDescriptor_t *lcd) {
+    LcdTransport_t *xfer = &lcd->xfer;
+    ktime_t start;
+    s64 left;
+
+    if (xfer->owed_ns > 2 * xfer->byte_ns)
+        _xfer_flush(lcd);
+
+    left = ktime_to_ns(ktime_sub(xfer->ready_at, ktime_get()));
+    if (left > 0 && lcd->busy_poll && left > LCD_POLL_BYTES * xfer->byte_ns) {
+        _xfer_flush(lcd);
+        _lcdpoll(lcd);
+        left = ktime_to_ns(ktime_sub(xfer->ready_at, ktime_get()));
+    }
+    if (left > 0) {
+        _xfer_flush(lcd);
+        start = ktime_get();
+        _ndelay_(left);
+        lcd->stats.delays++;
+        lcd->stats.delay_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+    }
+}
+
+/**
+ * sets execution time of last queued instruction or nibble
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u32 time in nanoseconds controller needs before next instruction
+ * @return none
+ *
+ */
+static void _lcdexec(LcdDescriptor_t *lcd, u32 nsecs) {
+    lcd->xfer.owed_ns = max(lcd->xfer.owed_ns, nsecs);
 }
 
 /**
- * write a byte to i2c device, strobing EN pin of LCD
+ * write a byte to i2c device, strobing EN pin of LCD. Every byte takes
+ * microseconds on the bus, which already covers enable pulse width.
  *
  * @param LcdData_t* lcd handler structure address
  * @param u8 byte to send to LCD
@@ -40,13 +396,13 @@ static void _buswrite(LcdDescriptor_t *lcd, u8 data) {
  */
 static void _strobe(LcdDescriptor_t *lcd, u8 data) {
     _buswrite(lcd, data | (1 << PIN_EN));
-    USLEEP(1);
     _buswrite(lcd, data & (~(1 << PIN_EN)));
-    USLEEP(50);
 }
 
 /**
- * write a byte using 4 bit interface
+ * write a byte using 4 bit interface. RS and RW lines have to be stable before
+ * EN goes high, so a setup write is queued only if any of them changes,
+ * otherwise expander already holds them.
  *
  * @param LcdData_t* lcd handler structure address
  * @param u8 byte to send to LCD
@@ -54,13 +410,125 @@ static void _strobe(LcdDescriptor_t *lcd, u8 data) {
  *
  */
 static void _write4bits(LcdDescriptor_t *lcd, u8 value) {
-    _buswrite(lcd, value);
+    const u8 ctrl = (1 << PIN_RS) | (1 << PIN_RW) | (1 << PIN_EN);
+
+    if ((lcd->xfer.state & ctrl) != (value & ctrl))
+        _buswrite(lcd, value);
     _strobe(lcd, value);
 }
 
 /**
- * write a byte to a LCD splitting byte into two nibbles
- * of 4 bits each.
+ * prepares transport for current adapter, picks burst mode if adapter is
+ * capable of plain I2C writes and limits the length of a single write
+ * to what adapter accepts.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _xfer_init(LcdDescriptor_t *lcd) {
+    struct i2c_adapter *adapter = lcd->driver_data.client->adapter;
+    LcdTransport_t *xfer = &lcd->xfer;
+
+    xfer->length = 0;
+    xfer->depth = 0;
+    xfer->error = 0;
+    xfer->state = 0xFF; //unknown, forces setup write of first nibble
+    xfer->burst = i2c_check_functionality(adapter, I2C_FUNC_I2C) ? 1 : 0;
+    xfer->max_length = LCD_XFER_BUFFER_SIZE;
+    if (adapter->quirks && adapter->quirks->max_write_len)
+        xfer->max_length = min_t(u16, xfer->max_length, adapter->quirks->max_write_len);
+
+    if (!lcd->timing.bus_hz && adapter->dev.parent)
+        device_property_read_u32(adapter->dev.parent, "clock-frequency", &lcd->timing.bus_hz);
+    if (!lcd->timing.bus_hz)
+        lcd->timing.bus_hz = LCD_DEFAULT_BUS_HZ;
+    //nothing valid is below the floors, 0 (or less) is an unset profile
+    if (lcd->timing.exec_ns < LCD_EXEC_MIN_NS)
+        lcd->timing.exec_ns = LCD_EXEC_NS;
+    if (lcd->timing.clear_ns < LCD_CLEAR_MIN_NS)
+        lcd->timing.clear_ns = LCD_CLEAR_NS;
+    xfer->byte_ns = LCD_BYTE_BITS * NSEC_PER_SEC / lcd->timing.bus_hz;
+    xfer->owed_ns = 0;
+    xfer->ready_at = ktime_get();
+}
+
+/**
+ * builds encoding table, expander writes of every byte for instruction
+ * and data register with current pinout and backlight
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _encodetable(LcdDescriptor_t *lcd) {
+    LcdTables_t *tables = &lcd->tables;
+    const u8 light = lcd->backlight ? (1 << PIN_BACKLIGHT) : 0;
+    u8 nibble[16], high, low;
+    uint v, b, rs;
+
+    for (v = 0; v < 16; v++) {
+        nibble[v] = light;
+        for (b = 0; b < 4; b++) {
+            if (v & (1 << b))
+                nibble[v] |= 1 << PINTR(4 + b);
+        }
+    }
+
+    for (rs = 0; rs < 2; rs++) {
+        for (v = 0; v < 256; v++) {
+            high = nibble[v >> 4] | (rs ? (1 << PIN_RS) : 0);
+            low = nibble[v & 0x0F] | (rs ? (1 << PIN_RS) : 0);
+            tables->bytes[rs][v][0] = high | (1 << PIN_EN);
+            tables->bytes[rs][v][1] = high;
+            tables->bytes[rs][v][2] = low | (1 << PIN_EN);
+            tables->bytes[rs][v][3] = low;
+        }
+    }
+    tables->ctrl = (1 << PIN_RS) | (1 << PIN_RW) | (1 << PIN_EN);
+}
+
+/**
+ * builds address table, DDRAM address of every column of every row with
+ * current topology, line mode and display shift
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _addrtable(LcdDescriptor_t *lcd) {
+    const u8 twolines = (lcd->display_function & LCD_FS_2LINES) == LCD_FS_2LINES;
+    u8 r, c, base;
+
+    for (r = 0; r < lcd->organization.rows; r++) {
+        base = lcd->organization.addresses[r];
+        for (c = 0; c < LCD_DDRAM_1LINE; c++) {
+            lcd->tables.addresses[r][c] = twolines ?
+                    (base & 0x40) | (((base & 0x3F) + c + lcd->shift) % LCD_DDRAM_LINE) :
+                    (base + c + lcd->shift) % LCD_DDRAM_1LINE;
+        }
+    }
+}
+
+/**
+ * sets display shift the controller was told to use
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 DDRAM line position shown in the first column
+ * @return none
+ *
+ */
+static void _setshift(LcdDescriptor_t *lcd, u8 shift) {
+    if (lcd->shift == shift)
+        return;
+    lcd->shift = shift;
+    _addrtable(lcd);
+}
+
+/**
+ * write a byte to a LCD as two nibbles of 4 bits each. Expander writes
+ * come from encoding table, RS and RW lines have to be stable before
+ * EN goes high, so a setup write is queued only if any of them changes.
  *
  * @param LcdData_t* lcd handler structure address
  * @param u8 byte to send to LCD
@@ -69,28 +537,177 @@ static void _write4bits(LcdDescriptor_t *lcd, u8 value) {
  *
  */
 static void lcdsend(LcdDescriptor_t *lcd, u8 value, u8 mode) {
-    u8 highnib = value & 0xF0;
-    u8 lownib = value << 4;
+    const u8 *bytes = lcd->tables.bytes[mode ? 1 : 0][value];
+    const u8 ctrl = lcd->tables.ctrl;
+
+    _lcdready(lcd);
+    if ((lcd->xfer.state & ctrl) != (bytes[1] & ctrl))
+        _busqueue(lcd, bytes + 1, 1);
+    _busqueue(lcd, bytes, 4);
+    _lcdexec(lcd, lcd->timing.exec_ns);
+    if (mode)
+        lcd->xfer.cells++;
+    else
+        lcd->xfer.commands++;
+}
+
+/**
+ * starts a group of operations sent to the bus together, controller traffic
+ * of everything until matching lcdend is coalesced into as few bursts as
+ * timing allows
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+void lcdbegin(LcdDescriptor_t *lcd) {
+    _xfer_begin(lcd);
+}
+
+/**
+ * ends a group of operations started by lcdbegin
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+void lcdend(LcdDescriptor_t *lcd) {
+    _xfer_end(lcd);
+}
+
+/**
+ * writes cells to a row starting at given column, which can go past visible
+ * columns into the part of DDRAM line which is off the screen. Only cells
+ * which differ from what the controller already holds are sent, one DDRAM
+ * address set per run of changed cells, the rest relies on address
+ * auto-increment. Everything is sent if full is set.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 row number
+ * @param u8 first column
+ * @param u8* cells to write
+ * @param u8 number of cells
+ * @param u8 true if all cells have to be sent
+ * @return u8 true if anything was sent
+ *
+ */
+static u8 _writerow(LcdDescriptor_t *lcd, u8 row, u8 column, const u8 *cells, u8 count, u8 full) {
+    u8 start = 0, end, gap, addr;
+    u8 sent = 0;
+
+    while (start < count) {
+        addr = lcdcelladdr(lcd, column + start, row);
+        if (!full && cells[start] == lcd->ddram[addr]) {
+            start++;
+            continue;
+        }
+
+        //extend the run over short gaps of unchanged cells, as long as addresses follow
+        for (end = start + 1, gap = 0; end < count && gap <= LCD_FLUSH_MAX_GAP &&
+                lcdcelladdr(lcd, column + end, row) == addr + (end - start); end++)
+            gap = (full || cells[end] != lcd->ddram[addr + (end - start)]) ? 0 : gap + 1;
+        end -= gap;
+
+        lcdcommand(lcd, LCD_DDRAM_SET | addr);
+        for (; start < end; start++, addr++) {
+            lcdsend(lcd, cells[start], (1 << PIN_RS));
+            lcd->ddram[addr] = cells[start];
+        }
+        sent = 1;
+    }
+    return sent;
+}
+
+/**
+ * refreshes raw_data from DDRAM shadow after the display shift changed,
+ * so it holds what's on the screen
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _lcdvisible(LcdDescriptor_t *lcd) {
+    const u8 columns = lcd->organization.columns;
+
+    for (u8 r = 0; r < lcd->organization.rows; r++) {
+        for (u8 c = 0; c < columns; c++)
+            lcd->raw_data[r * columns + c] = lcd->ddram[lcdcelladdr(lcd, c, r)];
+    }
+}
+
+/**
+ * writes cells to a row, see _writerow, raw_data is refreshed with cells
+ * which came into view. Cursor isn't restored, DDRAM address is left after
+ * the last cell sent.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 row number
+ * @param u8 first column, may be off the screen
+ * @param u8* cells to write
+ * @param u8 number of cells
+ * @return u8 true if anything was sent
+ *
+ */
+u8 lcdwriterow(LcdDescriptor_t *lcd, u8 row, u8 column, const u8 *cells, u8 count) {
+    u8 sent;
 
-    _write4bits(lcd, (highnib) | mode);
-    _write4bits(lcd, (lownib) | mode);
+    _xfer_begin(lcd);
+    sent = _writerow(lcd, row, column, cells, count, lcd->redraw);
+    _lcdvisible(lcd);
+    _xfer_end(lcd);
+    return sent;
 }
 
 /**
- * copy raw_data of raw_data from host to LCD
+ * accounts a flush in statistics and trace, data and instruction bytes it
+ * sent are what transport counted since the flush started
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 0 for the screen buffer, 1 for the back page
+ * @param u32 data bytes counted by transport when the flush started
+ * @param u32 instruction bytes counted by transport when the flush started
+ * @param ktime_t when the flush started
+ * @return none
+ *
+ */
+static void _flushdone(LcdDescriptor_t *lcd, u8 page, u32 cells, u32 commands, ktime_t start) {
+    const s64 elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+    cells = lcd->xfer.cells - cells;
+    commands = lcd->xfer.commands - commands;
+    lcd->stats.flushes++;
+    lcd->stats.cells += cells;
+    lcdstats_record(&lcd->stats.flush, elapsed);
+    trace_lcdi2c_flush(lcd, page, cells, commands, elapsed);
+}
+
+/**
+ * copy raw_data of raw_data from host to LCD. Only cells which differ from
+ * what the controller already holds are sent, one DDRAM address set per run
+ * of changed cells in a row, the rest relies on address auto-increment.
+ * Rows without changes cost nothing. After a failed transfer, or whenever
+ * redraw is requested, controller's content is unknown, so all cells are rewritten.
  *
  * @param LcdData_t* lcd handler structure address
  * @return none
  *
  */
 void lcdflushbuffer(LcdDescriptor_t *lcd) {
+    const u8 columns = lcd->organization.columns;
+    const u8 full = lcd->redraw;
     u8 col = lcd->column, row = lcd->row;
+    const u32 cells = lcd->xfer.cells, commands = lcd->xfer.commands;
+    const ktime_t start = ktime_get();
+    u8 sent = 0;
 
-    for (u8 i = 0; i < (lcd->organization.columns * lcd->organization.rows); i++) {
-        lcdcommand(lcd, LCD_DDRAM_SET + ITOMEMADDR(lcd, i));
-        lcdsend(lcd, lcd->raw_data[i], (1 << PIN_RS));
-    }
-    lcdsetcursor(lcd, col, row);
+    lcd->redraw = 0;
+    _xfer_begin(lcd);
+    for (u8 r = 0; r < lcd->organization.rows; r++)
+        sent |= _writerow(lcd, r, 0, lcd->raw_data + r * columns, columns, full);
+    if (sent)
+        lcdsetcursor(lcd, col, row);
+    _xfer_end(lcd);
+    _flushdone(lcd, 0, cells, commands, start);
 }
 
 /**
@@ -102,7 +719,9 @@ void lcdflushbuffer(LcdDescriptor_t *lcd) {
  *
  */
 void lcdcommand(LcdDescriptor_t *lcd, u8 data) {
+    _xfer_begin(lcd);
     lcdsend(lcd, data, 0);
+    _xfer_end(lcd);
 }
 
 /**
@@ -116,10 +735,13 @@ void lcdcommand(LcdDescriptor_t *lcd, u8 data) {
 void lcdwrite(LcdDescriptor_t *lcd, u8 data) {
     u8 memaddr;
 
-    memaddr = (lcd->column + (lcd->row * lcd->organization.columns)) % LCD_BUFFER_SIZE;
+    memaddr = lcd->column + (lcd->row * lcd->organization.columns);
     lcd->raw_data[memaddr] = data;
+    lcd->ddram[lcdcelladdr(lcd, lcd->column, lcd->row)] = data;
 
+    _xfer_begin(lcd);
     lcdsend(lcd, data, (1 << PIN_RS));
+    _xfer_end(lcd);
 }
 
 /**
@@ -137,7 +759,7 @@ void lcdwrite(LcdDescriptor_t *lcd, u8 data) {
 void lcdsetcursor(LcdDescriptor_t *lcd, u8 column, u8 row) {
     lcd->column = (column >= lcd->organization.columns ? 0 : column);
     lcd->row = (row >= lcd->organization.rows ? 0 : row);
-    lcdcommand(lcd, LCD_DDRAM_SET | PTOMEMADDR(lcd, lcd->column, lcd->row));
+    lcdcommand(lcd, LCD_DDRAM_SET | lcdcelladdr(lcd, lcd->column, lcd->row));
 }
 
 /**
@@ -151,7 +773,10 @@ void lcdsetcursor(LcdDescriptor_t *lcd, u8 column, u8 row) {
  */
 void lcdsetbacklight(LcdDescriptor_t *lcd, u8 backlight) {
     lcd->backlight = backlight;
+    _encodetable(lcd);
+    _xfer_begin(lcd);
     _buswrite(lcd, lcd->backlight ? (1 << PIN_BACKLIGHT) : 0);
+    _xfer_end(lcd);
 }
 
 /**
@@ -196,10 +821,19 @@ void lcdblink(LcdDescriptor_t *lcd, u8 blink) {
  *
  */
 void lcdhome(LcdDescriptor_t *lcd) {
+    const u8 shifted = lcd->shift;
+
+    _xfer_begin(lcd);
+    if (shifted)
+        lcdflushbuffer(lcd);
     lcd->column = 0;
     lcd->row = 0;
     lcdcommand(lcd, LCD_HOME);
-    MSLEEP(2);
+    _lcdexec(lcd, lcd->timing.clear_ns);
+    _setshift(lcd, 0); //home also takes display shift back
+    if (shifted)
+        _lcdvisible(lcd);
+    _xfer_end(lcd);
 }
 
 /**
@@ -212,14 +846,22 @@ void lcdhome(LcdDescriptor_t *lcd) {
  */
 void lcdclear(LcdDescriptor_t *lcd) {
     memset(lcd->raw_data, 0x20, LCD_BUFFER_SIZE); //Fill raw_data with spaces
+    memset(lcd->ddram, 0x20, LCD_DDRAM_SIZE); //Clear fills whole DDRAM with spaces
+    memset(lcd->back, 0x20, LCD_BUFFER_SIZE);
+    lcd->back_dirty = 0;
+    _setshift(lcd, 0);
+    _xfer_begin(lcd);
     lcdcommand(lcd, LCD_CLEAR);
-    MSLEEP(2);
+    _lcdexec(lcd, lcd->timing.clear_ns);
+    _xfer_end(lcd);
 }
 
 /**
  * scrolls content of a LCD horizontally. This is internal feature of HD44780
- * it scrolls content without actually changing content of internal RAM, so
- * raw_data of host stays intact as well
+ * it scrolls content without actually changing content of internal RAM, the
+ * window shown moves along DDRAM lines. Pending changes are sent first, then
+ * raw_data is refreshed with what came into view. Cursor stays in its place
+ * on the screen.
  *
  * @param LcdData_t* lcd handler structure address
  * @param u8 direction of a scroll, true - right, false - left
@@ -227,52 +869,185 @@ void lcdclear(LcdDescriptor_t *lcd) {
  *
  */
 void lcdscrollhoriz(LcdDescriptor_t *lcd, u8 direction) {
+    const u8 line = ((lcd->display_function & LCD_FS_2LINES) == LCD_FS_2LINES) ? LCD_DDRAM_LINE : LCD_DDRAM_1LINE;
+
+    _xfer_begin(lcd);
+    lcdflushbuffer(lcd);
     lcdcommand(lcd, LCD_DS_SHIFTDISPLAY |
                     (direction ? LCD_DS_SHIFTRIGHT : LCD_DS_SHIFTLEFT));
+    _setshift(lcd, (lcd->shift + (direction ? line - 1 : 1)) % line);
+    _lcdvisible(lcd);
+    lcdsetcursor(lcd, lcd->column, lcd->row);
+    _xfer_end(lcd);
+}
+
+/**
+ * tells whether a whole page fits in DDRAM columns which are off the
+ * screen, that's on 2-row displays whose rows take at most half of a
+ * DDRAM line, 16x2, 20x2 and 8x2 ones. Rows 2 and 3 of 4-row displays
+ * are the second halves of DDRAM lines, there's no room left on them.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return bool true if page flipping can be used
+ *
+ */
+bool lcdcanflip(LcdDescriptor_t *lcd) {
+    const u8 columns = lcd->organization.columns;
+    DECLARE_BITMAP(used, LCD_DDRAM_SIZE);
+    u8 r, c, addr;
+
+    bitmap_zero(used, LCD_DDRAM_SIZE);
+    for (r = 0; r < lcd->organization.rows; r++) {
+        for (c = 0; c < 2 * columns; c++) {
+            addr = lcdcelladdr(lcd, c, r);
+            if (__test_and_set_bit(addr, used))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * sends back page to the off-screen columns, right after the visible
+ * ones. Only cells which differ from what's already there are sent.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+void lcdflushpage(LcdDescriptor_t *lcd) {
+    const u8 columns = lcd->organization.columns;
+    const u32 cells = lcd->xfer.cells, commands = lcd->xfer.commands;
+    ktime_t start;
+    u8 sent = 0;
+
+    if (!lcd->back_dirty || !lcdcanflip(lcd))
+        return;
+
+    start = ktime_get();
+    lcd->back_dirty = 0;
+    _xfer_begin(lcd);
+    for (u8 r = 0; r < lcd->organization.rows; r++)
+        sent |= _writerow(lcd, r, columns, lcd->back + r * columns, columns, lcd->redraw);
+    if (sent)
+        lcdsetcursor(lcd, lcd->column, lcd->row);
+    _xfer_end(lcd);
+    _flushdone(lcd, 1, cells, commands, start);
+}
+
+/**
+ * shows back page by moving the display window over the off-screen
+ * columns, page shown so far goes off the screen and becomes the back
+ * page. Window moves by display shift commands the shorter way, or by
+ * return home if it comes back to the start of DDRAM lines. Shift is
+ * quicker than LCD crystals react, so the switch looks instant.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return int 0 on success, -EOPNOTSUPP if page doesn't fit off the screen
+ *
+ */
+int lcdflip(LcdDescriptor_t *lcd) {
+    const u8 columns = lcd->organization.columns;
+    const u8 line = ((lcd->display_function & LCD_FS_2LINES) == LCD_FS_2LINES) ? LCD_DDRAM_LINE : LCD_DDRAM_1LINE;
+    const u8 shift = (lcd->shift + columns) % line;
+    u8 r, c, n;
+
+    if (!lcdcanflip(lcd))
+        return -EOPNOTSUPP;
+
+    _xfer_begin(lcd);
+    lcdflushbuffer(lcd);
+    lcdflushpage(lcd);
+
+    if (!shift) {
+        lcdcommand(lcd, LCD_HOME);
+        _lcdexec(lcd, lcd->timing.clear_ns);
+    } else if (columns <= line - columns) {
+        for (n = 0; n < columns; n++)
+            lcdcommand(lcd, LCD_DS_SHIFTDISPLAY | LCD_DS_SHIFTLEFT);
+    } else {
+        for (n = 0; n < line - columns; n++)
+            lcdcommand(lcd, LCD_DS_SHIFTDISPLAY | LCD_DS_SHIFTRIGHT);
+    }
+    _setshift(lcd, shift);
+
+    _lcdvisible(lcd);
+    for (r = 0; r < lcd->organization.rows; r++) {
+        for (c = 0; c < columns; c++)
+            lcd->back[r * columns + c] = lcd->ddram[lcdcelladdr(lcd, columns + c, r)];
+    }
+    lcdsetcursor(lcd, lcd->column, lcd->row);
+    _xfer_end(lcd);
+    return 0;
 }
 
 /**
+ * scrolls content of raw_data vertically by one row, new row is filled with
+ * given line, padded with spaces if it's shorter than the row. LCD itself
+ * isn't touched, use lcdflushbuffer to send the result.
  *
  * @param LcdData_t* lcd handler structure address
+ * @param char* line of text for the row uncovered by the scroll
+ * @param uint length of the line
  * @param u8 direction of a scroll, true - down, false - up
+ * @return none
  *
  */
-void lcdscrollvert(LcdDescriptor_t *lcd, const char *line, uint len, u8 direction) {
+void lcdscrollbuffer(LcdDescriptor_t *lcd, const char *line, uint len, u8 direction) {
+    const u8 columns = lcd->organization.columns;
+    const uint rest = columns * (lcd->organization.rows - 1);
+    u8 *uncovered;
+
     if (direction) {
-        memcpy(lcd->raw_data + lcd->organization.columns,
-               lcd->raw_data,
-               lcd->organization.columns * (lcd->organization.rows - 1));
-        memcpy(lcd->raw_data, line, lcd->organization.columns);
+        memmove(lcd->raw_data + columns, lcd->raw_data, rest);
+        uncovered = lcd->raw_data;
     } else {
-        for (uint row = 1; row < lcd->organization.rows; row++) {
-            memcpy(lcd->raw_data + (row - 1) * lcd->organization.columns,
-                   lcd->raw_data + row * lcd->organization.columns,
-                   lcd->organization.columns);
-        }
-        memcpy(lcd->raw_data + (lcd->organization.rows - 1) * lcd->organization.columns, line, len);
+        memmove(lcd->raw_data, lcd->raw_data + columns, rest);
+        uncovered = lcd->raw_data + rest;
     }
+    len = min_t(uint, len, columns);
+    memcpy(uncovered, line, len);
+    memset(uncovered + len, ' ', columns - len);
+}
+
+/**
+ * scrolls content of raw_data vertically and sends the result to LCD
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param char* line of text for the row uncovered by the scroll
+ * @param uint length of the line
+ * @param u8 direction of a scroll, true - down, false - up
+ * @return none
+ *
+ */
+void lcdscrollvert(LcdDescriptor_t *lcd, const char *line, uint len, u8 direction) {
+    lcdscrollbuffer(lcd, line, len, direction);
     lcdflushbuffer(lcd);
 }
 
 /**
- * prints C string data on LCD, this function is doing some simple
+ * prints len character codes on LCD, this function is doing some simple
  * interpretation of some special characters in string, like \n \r or
  * backspace. Every carriage return or return character will move cursor
  * to line below current one and backspace character will move cursor to the
- * left until it reaches first character of the line. If string is longer, than
+ * left until it reaches first character of the line. If data is longer, than
  * what LCD is capable to display, cursor wraps around and print will overwrite
- * existing text.
+ * existing text. DDRAM address is set only when it doesn't follow from the
+ * previous character.
  *
  * @param LcdData_t* lcd handler structure address
- * @param char* data 0 terinated string
- * @return u8 bytes written
+ * @param u8* character codes to print, NUL is not special
+ * @param uint number of codes
+ * @return none
  *
  */
-u8 lcdprint(LcdDescriptor_t *lcd, const char *data) {
-    int i = 0;
-    const int max_len = (lcd->organization.columns * lcd->organization.rows);
+static void _printn(LcdDescriptor_t *lcd, const u8 *data, uint len) {
+    int next = -1;
+    uint i;
+    u8 addr;
 
-    do {
+    _xfer_begin(lcd);
+    for (i = 0; i < len; i++) {
         switch(data[i]) {
             case '\n':
             case '\r':
@@ -280,26 +1055,145 @@ u8 lcdprint(LcdDescriptor_t *lcd, const char *data) {
                     //counter
                     lcd->column = 0;
                 lcd->row = (lcd->row + 1) % lcd->organization.rows;
-                i++;
-                continue;
+                break;
             case 0x08: //BS
                 if (lcd->column > 0)
                     lcd->column -= 1;
-                i++;
-                continue;
+                break;
             default:
-                lcdcommand(lcd, LCD_DDRAM_SET | PTOMEMADDR(lcd, lcd->column, lcd->row));
+                addr = lcdcelladdr(lcd, lcd->column, lcd->row);
+                if (addr != next)
+                    lcdcommand(lcd, LCD_DDRAM_SET | addr);
                 lcdwrite(lcd, data[i]);
-                lcd->column = (lcd->column + 1) % lcd->organization.columns;
-                if (lcd->column == 0)
+                next = addr + 1;
+                if (++lcd->column == lcd->organization.columns) {
+                    lcd->column = 0;
                     lcd->row = (lcd->row + 1) % lcd->organization.rows;
-                i++;
+                }
                 break;
         }
-    } while (i < max_len && data[i]);
+    }
+    _xfer_end(lcd);
+}
+
+/**
+ * prints len bytes of data on LCD, see _printn. Unless display's character
+ * set is raw, data is UTF-8 text translated to character codes first.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param char* data to print, NUL is not special
+ * @param uint number of bytes in data
+ * @return u8 cursor offset in buffer after printing
+ *
+ */
+u8 lcdprintn(LcdDescriptor_t *lcd, const char *data, uint len) {
+    const u8 *bytes = (const u8 *) data;
+    u8 cells[LCD_BUFFER_SIZE];
+    uint used, count;
+
+    _xfer_begin(lcd);
+    if (lcd->charset.mode == LCD_CHARSET_RAW) {
+        _printn(lcd, bytes, len);
+    } else {
+        while (len) {
+            count = lcdcharset_translate(lcd, bytes, len, cells, sizeof(cells), &used);
+            _printn(lcd, cells, count);
+            bytes += used;
+            len -= used;
+        }
+    }
+    _xfer_end(lcd);
+
     return (lcd->column + (lcd->row * lcd->organization.columns));
 }
 
+/**
+ * prints C string data on LCD, see lcdprintn. At most as many bytes
+ * as the LCD has cells are taken from the string.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param char* data 0 terinated string
+ * @return u8 cursor offset in buffer after printing
+ *
+ */
+u8 lcdprint(LcdDescriptor_t *lcd, const char *data) {
+    return lcdprintn(lcd, data, strnlen(data, lcd->organization.columns * lcd->organization.rows));
+}
+
+/**
+ * defines consecutive custom characters, it is feature of HD44780 controller.
+ * Characters whose slot already holds the same bitmap are skipped, others are
+ * sent in one auto-increment burst per run of slots. DDRAM address is set
+ * back to the cursor position afterwards.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 first character number to define 0-7
+ * @param u8 number of characters
+ * @param CustomChar_t* bitmap definitions, 8 bytes each
+ * @return none
+ *
+ */
+void lcdcustomchars(LcdDescriptor_t *lcd, u8 first, u8 count, const CustomChar_t *bitmaps) {
+    int next = -1;
+    u8 i, j, num;
+
+    _xfer_begin(lcd);
+    for (i = 0; i < count; i++) {
+        num = (first + i) & 0x07;
+        if ((lcd->cgram_valid & (1 << num)) && !memcmp(lcd->custom_chars[num], bitmaps[i], sizeof(CustomChar_t)))
+            continue;
+
+        if (num != next)
+            lcdcommand(lcd, LCD_CGRAM_SET | (num << 3));
+        for (j = 0; j < 8; j++) {
+            lcd->custom_chars[num][j] = bitmaps[i][j];
+            lcdsend(lcd, bitmaps[i][j], (1 << PIN_RS));
+        }
+        lcd->cgram_valid |= 1 << num;
+        lcd->stats.cgram_uploads++;
+        next = num + 1;
+    }
+    if (next >= 0)
+        lcdcommand(lcd, LCD_DDRAM_SET | PTOMEMADDR(lcd, lcd->column, lcd->row));
+    _xfer_end(lcd);
+}
+
+/**
+ * redefines custom character sending only bitmap rows which differ from
+ * what the slot holds, used for animation frames. DDRAM address is set back
+ * to the cursor position afterwards.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 character number to define 0-7
+ * @param u8* array of 8 bytes of bitmap definition
+ * @return none
+ *
+ */
+void lcdcustomcharrows(LcdDescriptor_t *lcd, u8 num, const u8 *bitmap) {
+    const u8 valid = lcd->cgram_valid & (1 << (num & 0x07));
+    int next = -1;
+    u8 r;
+
+    num &= 0x07;
+    _xfer_begin(lcd);
+    for (r = 0; r < 8; r++) {
+        if (valid && lcd->custom_chars[num][r] == bitmap[r])
+            continue;
+
+        if (r != next)
+            lcdcommand(lcd, LCD_CGRAM_SET | (num << 3) | r);
+        lcd->custom_chars[num][r] = bitmap[r];
+        lcdsend(lcd, bitmap[r], (1 << PIN_RS));
+        next = r + 1;
+    }
+    lcd->cgram_valid |= 1 << num;
+    if (next >= 0) {
+        lcd->stats.cgram_uploads++;
+        lcdcommand(lcd, LCD_DDRAM_SET | PTOMEMADDR(lcd, lcd->column, lcd->row));
+    }
+    _xfer_end(lcd);
+}
+
 /**
  * allows to define custom character. It is feature of HD44780 controller.
  *
@@ -310,15 +1204,290 @@ u8 lcdprint(LcdDescriptor_t *lcd, const char *data) {
  *
  */
 void lcdcustomchar(LcdDescriptor_t *lcd, u8 num, const u8 *bitmap) {
-    u8 i;
+    lcdcustomchars(lcd, num & 0x07, 1, (const CustomChar_t *) bitmap);
+}
 
-    num &= 0x07;
-    lcdcommand(lcd, LCD_CGRAM_SET | (num << 3));
+/**
+ * publishes current state for readers, called by writers once they're
+ * done with their changes. Generation is bumped and pollers are woken
+ * only if something visible actually changed.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+void lcdpublish(LcdDescriptor_t *lcd) {
+    LcdSnapshot_t *view = &lcd->view;
+
+    //Writers are serialized, view can be compared without the seqlock
+    if (!memcmp(view->raw_data, lcd->raw_data, LCD_BUFFER_SIZE) &&
+        !memcmp(view->custom_chars, lcd->custom_chars, sizeof(view->custom_chars)) &&
+        view->column == lcd->column && view->row == lcd->row &&
+        view->backlight == lcd->backlight && view->cursor == lcd->cursor &&
+        view->blink == lcd->blink)
+        return;
+
+    write_seqlock(&lcd->view_lock);
+    memcpy(view->raw_data, lcd->raw_data, LCD_BUFFER_SIZE);
+    memcpy(view->custom_chars, lcd->custom_chars, sizeof(view->custom_chars));
+    view->column = lcd->column;
+    view->row = lcd->row;
+    view->backlight = lcd->backlight;
+    view->cursor = lcd->cursor;
+    view->blink = lcd->blink;
+    view->generation++;
+    write_sequnlock(&lcd->view_lock);
+
+    wake_up_interruptible(&lcd->change_wq);
+}
+
+/**
+ * takes consistent copy of the last published state without waiting
+ * for writers
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param LcdSnapshot_t* where to store the copy
+ * @return none
+ *
+ */
+void lcdsnapshot(LcdDescriptor_t *lcd, LcdSnapshot_t *snapshot) {
+    unsigned int seq;
+
+    do {
+        seq = read_seqbegin(&lcd->view_lock);
+        memcpy(snapshot, &lcd->view, sizeof(LcdSnapshot_t));
+    } while (read_seqretry(&lcd->view_lock, seq));
+}
+
+/**
+ * generation of the last published state, without the rest of it
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return u64 generation
+ *
+ */
+u64 lcdgeneration(LcdDescriptor_t *lcd) {
+    unsigned int seq;
+    u64 generation;
+
+    do {
+        seq = read_seqbegin(&lcd->view_lock);
+        generation = lcd->view.generation;
+    } while (read_seqretry(&lcd->view_lock, seq));
+
+    return generation;
+}
+
+/**
+ * reads busy flag and address counter of the controller
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8* busy flag (bit 7) and address counter (bits 0-6)
+ * @return int 0 on success, negative error code otherwise
+ *
+ */
+int lcdreadstatus(LcdDescriptor_t *lcd, u8 *status) {
+    return _lcdread(lcd, LCD_MODE_COMMAND, status, 1);
+}
+
+/**
+ * checks if busy flag can be read on this backpack. Many of them have RW
+ * tied to ground, then data lines are never driven by the LCD and reading
+ * gives garbage. Address counter is set to a known value and read back,
+ * polling is enabled only if it matches. Cursor position is restored.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return u8 1 if busy flag polling is usable, 0 otherwise
+ *
+ */
+u8 lcdbusyprobe(LcdDescriptor_t *lcd) {
+    u8 status = 0;
+    int ret;
+
+    lcd->busy_poll = 0;
+    _xfer_begin(lcd);
+    lcdcommand(lcd, LCD_DDRAM_SET | LCD_PROBE_ADDRESS);
+    _xfer_flush(lcd);
+    _lcdready(lcd);
+    ret = lcdreadstatus(lcd, &status);
+    lcd->busy_poll = (!ret && status == LCD_PROBE_ADDRESS);
+    lcdsetcursor(lcd, lcd->column, lcd->row);
+    _xfer_end(lcd);
 
-    for (i = 0; i < 8; i++) {
-        lcd->custom_chars[num][i] = bitmap[i];
-        lcdsend(lcd, bitmap[i], (1 << PIN_RS));
+    if (!lcd->busy_poll)
+        dev_warn(&lcd->driver_data.client->dev,
+                 "busy flag not readable (ret: %d, status: 0x%02X), using fixed timings\n", ret, status);
+    return lcd->busy_poll;
+}
+
+/**
+ * tells whether controller is done with what was sent once the execution
+ * time it was given is over. Busy flag is sampled a few bytes into the
+ * status read, the read starts early enough for that to happen before the
+ * time is over, so a pass means no later write can find the controller
+ * busy. Time too short for the read to make it can't be checked over this
+ * bus and doesn't pass. If controller is still busy, it's waited for, so
+ * nothing is ever written to a busy controller.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return int 0 if controller was ready, 1 if it wasn't or time couldn't be checked,
+ * negative error code on failure
+ *
+ */
+static int _calibready(LcdDescriptor_t *lcd) {
+    s64 left;
+    u8 status;
+    int ret;
+
+    _xfer_flush(lcd);
+    left = ktime_to_ns(ktime_sub(lcd->xfer.ready_at, ktime_get())) - LCD_STATUS_LEAD_BYTES * lcd->xfer.byte_ns;
+    if (left > 0)
+        _ndelay_(left);
+    ret = lcdreadstatus(lcd, &status);
+    if (ret)
+        return ret;
+    if (!(status & LCD_BUSY_FLAG))
+        return left < 0 ? 1 : 0;
+
+    lcd->xfer.ready_at = ktime_add_ns(ktime_get(), LCD_CLEAR_NS);
+    _lcdpoll(lcd);
+    _lcdready(lcd);
+    return 1;
+}
+
+/**
+ * writes a pattern to the first row with current execution time, checking
+ * after every instruction that controller is ready when the time is over
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 round number, varies the pattern
+ * @return int 0 if controller kept up, 1 if it didn't, negative error code on failure
+ *
+ */
+static int _calibexec(LcdDescriptor_t *lcd, u8 round) {
+    const u8 len = lcd->organization.columns;
+    int ret;
+
+    _xfer_begin(lcd);
+    lcdcommand(lcd, LCD_DDRAM_SET | lcd->organization.addresses[0]);
+    ret = _calibready(lcd);
+    for (u8 i = 0; i < len && !ret; i++) {
+        lcdsend(lcd, 'A' + (i * 7 + round) % 26, LCD_MODE_DATA);
+        ret = _calibready(lcd);
     }
+    _xfer_end(lcd);
+
+    return ret;
+}
+
+/**
+ * clears the display with current clear time and checks that controller
+ * is ready when the time is over
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 round number, not used
+ * @return int 0 if controller kept up, 1 if it didn't, negative error code on failure
+ *
+ */
+static int _calibclear(LcdDescriptor_t *lcd, u8 round) {
+    int ret;
+
+    _xfer_begin(lcd);
+    lcdcommand(lcd, LCD_CLEAR);
+    _lcdexec(lcd, lcd->timing.clear_ns);
+    ret = _calibready(lcd);
+    _xfer_end(lcd);
+
+    return ret;
+}
+
+/**
+ * finds the shortest of given times for which the test passes every round
+ * and stores it with margin. If none passes, field gets the value it had
+ * before calibration.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u32* timing field under test
+ * @param u32 value of the field before calibration
+ * @param u32* candidates, longest first
+ * @param uint number of candidates
+ * @param test function
+ * @return int 0 on success, negative error code otherwise
+ *
+ */
+static int _calibrate(LcdDescriptor_t *lcd, u32 *field, u32 previous, const u32 *candidates, uint num,
+                      int (*test)(LcdDescriptor_t *, u8)) {
+    u32 best = *field;
+    u8 passed = 0;
+    int ret = 0;
+
+    for (uint c = 0; c < num && candidates[c] <= best; c++) {
+        *field = candidates[c];
+        for (u8 round = 0; round < LCD_CALIBRATION_ROUNDS && !ret; round++)
+            ret = test(lcd, round);
+        if (ret)
+            break;
+        best = candidates[c];
+        passed = 1;
+    }
+
+    *field = passed ? best + best / 100 * LCD_CALIBRATION_MARGIN : previous;
+    return ret < 0 ? ret : 0;
+}
+
+/**
+ * finds the fastest timing this particular controller handles reliably.
+ * Progressively shorter execution times are tried, each one is checked by
+ * reading busy flag as soon as it's over, so it works only on backpacks
+ * with RW line connected. Bus time counts too, the result is what the
+ * controller needs over this bus. It's stored with a safety margin in
+ * timing profile, never below the floors of LCD_EXEC_MIN_NS and
+ * LCD_CLEAR_MIN_NS, time for which no candidate passes is left as it was.
+ * Where a status read takes longer on the bus than LCD_EXEC_NS only clear
+ * time is calibrated. Content of the LCD is redrawn afterwards.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return int 0 on success, negative error code otherwise
+ *
+ */
+int lcdcalibrate(LcdDescriptor_t *lcd) {
+    static const u32 exec_candidates[] = {
+            LCD_EXEC_NS, 40000, 32000, 24000, 16000, 8000, LCD_EXEC_MIN_NS,
+    };
+    static const u32 clear_candidates[] = {
+            LCD_CLEAR_NS, 1700000, 1520000, 1300000, 1000000, 800000, 600000, 400000, LCD_CLEAR_MIN_NS,
+    };
+    const LcdTiming_t saved = lcd->timing;
+    const u8 poll = lcd->busy_poll;
+    int ret;
+
+    if (!lcdbusyprobe(lcd)) {
+        lcd->busy_poll = poll;
+        return -EOPNOTSUPP;
+    }
+    lcd->busy_poll = 0;
+
+    ret = 0;
+    //status read takes longer than any instruction time on slow buses, there's nothing to tell apart
+    if (LCD_STATUS_LEAD_BYTES * lcd->xfer.byte_ns < LCD_EXEC_NS) {
+        lcd->timing.exec_ns = LCD_EXEC_NS;
+        ret = _calibrate(lcd, &lcd->timing.exec_ns, saved.exec_ns,
+                         exec_candidates, ARRAY_SIZE(exec_candidates), _calibexec);
+    }
+    lcd->timing.clear_ns = LCD_CLEAR_NS;
+    if (!ret)
+        ret = _calibrate(lcd, &lcd->timing.clear_ns, saved.clear_ns,
+                         clear_candidates, ARRAY_SIZE(clear_candidates), _calibclear);
+    if (ret)
+        lcd->timing = saved;
+
+    lcd->busy_poll = poll;
+    memset(lcd->ddram, 0x20, LCD_DDRAM_SIZE);
+    _setshift(lcd, 0); //calibration clears the display
+    lcd->redraw = 1;
+    lcdflushbuffer(lcd);
+
+    return ret;
 }
 
 /**
@@ -329,9 +1498,11 @@ void lcdcustomchar(LcdDescriptor_t *lcd, u8 num, const u8 *bitmap) {
  *
  */
 void lcdfinalize(LcdDescriptor_t *lcd) {
+    _xfer_begin(lcd);
     lcdsetbacklight(lcd, 0);
     lcdclear(lcd);
     lcdcommand(lcd, LCD_DC_DISPLAYOFF | LCD_DC_CURSOROFF | LCD_DC_CURSORBLINKOFF);
+    _xfer_end(lcd);
 }
 
 /**
@@ -344,6 +1515,8 @@ void lcdfinalize(LcdDescriptor_t *lcd) {
  */
 void lcdinit(LcdDescriptor_t *lcd, lcd_topology_t topo) {
     memset(lcd->raw_data, 0x20, LCD_BUFFER_SIZE); //Fill raw_data with spaces
+    lcd->cgram_valid = 0; //CGRAM content is unknown until characters are defined
+    lcdterm_reset(&lcd->term);
 
     if (topo > LCD_TOPO_8x2)
         topo = LCD_TOPO_16x2;
@@ -360,20 +1533,31 @@ void lcdinit(LcdDescriptor_t *lcd, lcd_topology_t topo) {
     if (lcd->organization.rows > 1)
         lcd->display_function |= LCD_FS_2LINES;
 
-    MSLEEP(50);
+    lcd->shift = 0;
+    _encodetable(lcd);
+    _addrtable(lcd);
+
+    _xfer_init(lcd);
+    _xfer_begin(lcd);
+
     _buswrite(lcd, lcd->backlight ? (1 << PIN_BACKLIGHT) : 0);
-    MSLEEP(100);
+    _lcdexec(lcd, LCD_POWERON_NS);
 
+    _lcdready(lcd);
     _write4bits(lcd, (1 << PIN_DB4) | (1 << PIN_DB5));
-    MSLEEP(5);
+    _lcdexec(lcd, LCD_INIT1_NS);
 
+    _lcdready(lcd);
     _write4bits(lcd, (1 << PIN_DB4) | (1 << PIN_DB5));
-    MSLEEP(5);
+    _lcdexec(lcd, LCD_INIT2_NS);
 
+    _lcdready(lcd);
     _write4bits(lcd, (1 << PIN_DB4) | (1 << PIN_DB5));
-    MSLEEP(15);
+    _lcdexec(lcd, lcd->timing.exec_ns);
 
+    _lcdready(lcd);
     _write4bits(lcd, (1 << PIN_DB5));
+    _lcdexec(lcd, lcd->timing.exec_ns);
 
     lcdcommand(lcd, lcd->display_function);
 
@@ -386,4 +1570,9 @@ void lcdinit(LcdDescriptor_t *lcd, lcd_topology_t topo) {
     lcdsetcursor(lcd, lcd->column, lcd->row);
     lcdcursor(lcd, lcd->cursor);
     lcdblink(lcd, lcd->blink);
+    _xfer_end(lcd);
+
+    lcd->busy_poll = 0;
+    if (lcd->busy_flag)
+        lcdbusyprobe(lcd);
 }
@@ -9,6 +9,21 @@
 #include <linux/i2c.h>
 #include <linux/types.h>
 #include <linux/semaphore.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/seqlock.h>
+#include <linux/wait.h>
+#include <linux/mutex.h>
+#include <linux/kfifo.h>
+#include <linux/hrtimer.h>
+#include <linux/kref.h>
+
+#include "lcdsched.h"
+#include "lcdglyph.h"
+#include "lcdeffects.h"
+#include "lcdcharset.h"
+#include "lcdstats.h"
+#include "lcdterm.h"
 
 #define LCDI2C_DESCRIPTION "LCD driver for PCF8574 I2C expander"
 #define LCDI2C_VERSION "0.2.1"
@@ -39,9 +54,19 @@ extern uint pinout[8];
 #define DEFAULT_CHIP_ADDRESS (0x27)
 #define LCD_BUFFER_SIZE (20 * 4 + 4)   //20 columns * 4 rows + 4 extra chars
 #define LCD_MAX_LINE_LENGTH (40)       //Maximum line length in characters (usually less than 40)
+#define LCD_FB_CELLS (4 * LCD_MAX_LINE_LENGTH) //Character cells in mmap()ed framebuffer, enough for any topology
+#define LCD_BATCH_MAX_OPS (64)         //Operations accepted by a single BATCH ioctl
+#define LCD_DDRAM_SIZE (0x80)          //DDRAM address space, two lines of 40 bytes at 0x00 and 0x40
+#define LCD_DDRAM_LINE (40)            //DDRAM line length in two-line mode
+#define LCD_DDRAM_1LINE (80)           //DDRAM line length in one-line mode
+#define LCD_FLUSH_MAX_GAP (1)          //Unchanged cells re-sent rather than paying for a new DDRAM address
 #define LCD_DEFAULT_COLS (16)
 #define LCD_DEFAULT_ROWS (2)
 #define LCD_DEFAULT_ORGANIZATION LCD_TOPO_16x2
+#define LCD_DEFAULT_FRAMERATE (20)     //Write-back flushes per second
+#define LCD_MAX_FRAMERATE (100)
+#define LCD_STREAM_MIN_SIZE (128)     //Stream mode ring size limits, rounded up to power of 2
+#define LCD_STREAM_MAX_SIZE (65536)
 
 //for convenience
 #define LCD_MODE_COMMAND        (0)
@@ -91,15 +116,45 @@ extern uint pinout[8];
 
 
 #define USLEEP(usecs) _udelay_(usecs)
-#define MSLEEP(msecs) mdelay(msecs)
-
+#define MSLEEP(msecs) msleep(msecs)
+
+//Timing defaults, HD44780 datasheet values with some margin for slower clones
+#define LCD_DEFAULT_BUS_HZ (100000)    //PCF8574 is specified for 100kHz
+#define LCD_EXEC_NS (50 * NSEC_PER_USEC)        //Regular instruction, 37us in datasheet
+#define LCD_CLEAR_NS (2 * NSEC_PER_MSEC)        //Clear display and return home, 1.52ms in datasheet
+#define LCD_EXEC_MIN_NS (4 * NSEC_PER_USEC)     //Shortest instruction time accepted, 0 means the default
+#define LCD_CLEAR_MIN_NS (200 * NSEC_PER_USEC)  //Shortest clear time accepted, 0 means the default
+#define LCD_POWERON_NS (50 * NSEC_PER_MSEC)     //Vcc rise to first instruction, 40ms in datasheet
+#define LCD_INIT1_NS (4100 * NSEC_PER_USEC)     //After first function set in 8 bit mode
+#define LCD_INIT2_NS (100 * NSEC_PER_USEC)      //After second function set in 8 bit mode
+#define LCD_BYTE_BITS (9)                       //Bits on the bus per expander byte, data and ACK
+#define LCD_SPIN_MAX_NS (10 * NSEC_PER_USEC)    //Shorter waits are spun, longer ones sleep
+#define LCD_POLL_BYTES (9)                      //Bus time of a busy flag poll, in expander bytes
+#define LCD_STATUS_LEAD_BYTES (5)               //Bus time from the start of a status read to busy flag sample, at most
+
+#define LCD_BUSY_FLAG (0x80)
+#define LCD_AC_MASK (0x7F)
+#define LCD_PROBE_ADDRESS (0x12)                //DDRAM address used to check if busy flag can be read
+#define LCD_CALIBRATION_ROUNDS (4)              //Passes every candidate timing has to survive
+#define LCD_CALIBRATION_MARGIN (25)             //Percent added to the fastest timing that passed
+
+//Bus access, a host build (see bench/) defines its own backend before this header
+#ifndef LOWLEVEL_WRITE
 #define LOWLEVEL_WRITE(client, data) i2c_smbus_write_byte(client, data)
+#define LOWLEVEL_READ(client) i2c_smbus_read_byte(client)
+#define LOWLEVEL_TRANSFER(client, msgs, num) i2c_transfer((client)->adapter, msgs, num)
+#define LOWLEVEL_BURST(client, msg) __i2c_transfer((client)->adapter, msg, 1)
+#define LOWLEVEL_LOCK(client) i2c_lock_bus((client)->adapter, I2C_LOCK_SEGMENT)
+#define LOWLEVEL_UNLOCK(client) i2c_unlock_bus((client)->adapter, I2C_LOCK_SEGMENT)
+#endif
+
+#define LCD_XFER_BUFFER_SIZE (128)     //Expander bytes queued before a burst is pushed to the bus
 //Byte index to position as row and column
 #define ITOP(data, i, col, row) *(&col) = (u8) ((i) % data->organization.columns); *(&row) = (u8) ((i) / data->organization.columns)
 //Byte index to memory address
 #define ITOMEMADDR(data, i)   (((i) % data->organization.columns) + data->organization.addresses[((i) / data->organization.columns)])
-//Position as row and column to memory address
-#define PTOMEMADDR(data, col, row) ((col % data->organization.columns) + data->organization.addresses[(row % data->organization.rows)])
+//Position as row and column to memory address, display shift included
+#define PTOMEMADDR(data, col, row) lcdcelladdr(data, (col) % data->organization.columns, (row) % data->organization.rows)
 
 typedef enum {
     LCD_TOPO_40x2 = 0,
@@ -165,12 +220,94 @@ typedef struct lcdi2c_driver
     struct device *lcdi2c_device;
     struct cdev cdev;
     struct semaphore sem;
+    struct workqueue_struct *wq;
+    struct delayed_work flush_work; //write-back flush, coalesces all updates since last frame
+    ktime_t last_flush;
+    u32 framerate;
+    u8 writeback;
+    struct kfifo stream;            //stream mode ring, write() appends, stream_work prints it in order
+    struct mutex stream_mutex;      //one writer at a time, so writes aren't interleaved
+    wait_queue_head_t stream_wq;    //writers waiting for space in the ring
+    struct work_struct stream_work;
+    struct hrtimer effects_timer;   //wakes effects_work when the next effect step is due
+    struct work_struct effects_work;
+    struct dentry *debugfs;         //statistics directory of the display
+    struct kref ref;                //held by the device and every open file, last one frees the descriptor
+    u8 gone;                        //device was removed, files still open get ENODEV
 } Lcdi2cDriver_t;
 
+/*
+  Transport state. Every expander state change is queued in buffer and pushed to the bus
+  as one I2C write per frame (or per max_length bytes if adapter limits length of a
+  message), instead of separate SMBus write for every state change. Adapter lock is held
+  from first chunk of a frame until the frame ends, so bytes of a frame aren't interleaved
+  with traffic of other devices, unless another display on the adapter waits for its turn,
+  then frame is split into short chunks and bus is handed over between them. Adapters without plain I2C support fall back to
+  byte-by-byte SMBus writes.
+*/
+typedef struct lcd_transport
+{
+    u8 buffer[LCD_XFER_BUFFER_SIZE];
+    u16 length;
+    u16 max_length;
+    u8 state;       //last byte latched by the expander
+    u8 depth;       //frame nesting level, frame is sent when it drops to 0
+    u8 burst;       //adapter supports plain I2C writes
+    u8 locked;      //display has its turn on the bus, adapter is locked in burst mode
+    int error;      //last transfer error
+    u32 byte_ns;    //bus time of one expander byte
+    u32 owed_ns;    //execution time of last instruction not yet covered by queued bytes
+    ktime_t ready_at;   //when controller finishes instructions already sent
+    u32 cells;          //data bytes sent to the controller so far
+    u32 commands;       //instruction bytes sent to the controller so far
+} LcdTransport_t;
+
+/*
+  Controller timing. Execution times are satisfied by bus time of bytes that follow
+  an instruction whenever possible, only what's left is waited for.
+*/
+typedef struct lcd_timing
+{
+    u32 bus_hz;     //adapter clock
+    u32 exec_ns;    //regular instruction execution time
+    u32 clear_ns;   //clear display and return home execution time
+} LcdTiming_t;
+
+/*
+  Tables of the hot path, so bytes and addresses are looked up instead of computed. Every
+  byte sent to the controller is four expander writes, high nibble with EN high then low
+  and low nibble the same way, pinout and backlight already applied. Encoding is rebuilt
+  on init and when backlight changes, addresses on init and when display shift changes.
+*/
+typedef struct lcd_tables
+{
+    u8 bytes[2][256][4];                //expander writes of a byte, [0] - instruction, [1] - data
+    u8 ctrl;                            //RS, RW and EN pins, they have to be stable before EN goes high
+    u8 addresses[4][LCD_DDRAM_1LINE];   //DDRAM address of every column of a row, display shift included
+} LcdTables_t;
+
 typedef u8 LcdBuffer_t[LCD_BUFFER_SIZE];
 typedef u8 CustomChar_t[8];
 typedef u8 LcdLine_t[LCD_MAX_LINE_LENGTH];
 
+/*
+  Copy of user visible state published by writers when they're done, readers take it
+  under seqlock and never wait for bus transfers in progress. Generation grows with
+  every published change, it's also what LCD_IOCTL_GETSTATE returns.
+*/
+typedef struct lcd_snapshot
+{
+    u64 generation;
+    LcdBuffer_t raw_data;
+    CustomChar_t custom_chars[8];
+    u8 column;
+    u8 row;
+    u8 backlight;
+    u8 cursor;
+    u8 blink;
+    u8 reserved[7];
+} LcdSnapshot_t;
+
 typedef struct LcdBufferArgs_t {
     LcdBuffer_t buffer;
 } LcdBufferArgs_t;
@@ -202,11 +339,92 @@ typedef struct LcdCustomCharArgs_t {
     CustomChar_t custom_char;
 } LcdCustomCharArgs_t;
 
+/*
+  Damage rectangle of COMMIT ioctl, zero columns or rows (or no argument at all) commits
+  the whole screen
+*/
+typedef struct LcdCommitArgs_t {
+    u8 column;
+    u8 row;
+    u8 columns;
+    u8 rows;
+} LcdCommitArgs_t;
+
+/*
+  Window of SETWINDOW ioctl, region of the screen claimed by an open file, zero columns
+  and rows give the whole screen back
+*/
+typedef struct LcdWindowArgs_t {
+    u8 column;
+    u8 row;
+    u8 columns;
+    u8 rows;
+} LcdWindowArgs_t;
+
+/*
+  Operations of BATCH ioctl
+*/
+typedef enum lcd_batch_op {
+    LCD_BATCH_POSITION = 1,     //move cursor to column, row
+    LCD_BATCH_TEXT,             //write value bytes of data at column, row, cursor follows the text
+    LCD_BATCH_LINE,             //set whole row from data
+    LCD_BATCH_CUSTOMCHAR,       //define custom character value from first 8 bytes of data
+    LCD_BATCH_BACKLIGHT,        //switch backlight to value
+    LCD_BATCH_CURSOR,           //show cursor if value is not 0
+    LCD_BATCH_BLINK,            //blink cursor if value is not 0
+    LCD_BATCH_CLEAR,            //clear display
+    LCD_BATCH_GLYPHS,           //put value glyphs, ids in data, at column, row, cursor follows them
+} lcd_batch_op_t;
+
+typedef struct LcdBatchOp_t {
+    u8 op;
+    u8 column;
+    u8 row;
+    u8 value;
+    s32 status;                 //result of the operation, set by driver
+    u8 data[LCD_MAX_LINE_LENGTH];
+} LcdBatchOp_t;
+
+typedef struct LcdBatchArgs_t {
+    u32 count;                  //number of operations in ops
+    u8 column;                  //cursor position after the batch, set by driver
+    u8 row;
+    u8 reserved[2];
+    u64 ops;                    //user address of LcdBatchOp_t array
+} LcdBatchArgs_t;
+
+/*
+  Layout of the page shared with userspace through mmap() of the device. Applications
+  compose the screen in cells (row after row, columns cells each) and custom_chars,
+  nothing reaches the LCD until COMMIT ioctl. Geometry fields are filled by the driver.
+  custom_chars is a copy of CGRAM taken by the first mapping only, it isn't updated when
+  glyph paging, animations or other writers redefine slots later. COMMIT uploads just the
+  slots changed in the page since the mapping or previous COMMIT and never touches animated
+  slots, slot written this way is seen by the glyph table as any other bitmap in CGRAM.
+*/
+typedef struct lcd_framebuffer {
+    u8 columns;
+    u8 rows;
+    u8 reserved[2];
+    u8 cells[LCD_FB_CELLS];
+    CustomChar_t custom_chars[8];
+} LcdFramebuffer_t;
+
 
 typedef struct LcdDescriptor_t
 {
     Lcdi2cDriver_t driver_data;
     LcdOrganization_t organization;
+    LcdTransport_t xfer;
+    LcdTiming_t timing;
+    LcdSchedClient_t sched;
+    LcdTables_t tables;
+    LcdFramebuffer_t *fb;       //page shared with userspace by mmap()
+    CustomChar_t fb_committed[8]; //fb custom_chars as of first mapping or last COMMIT
+    seqlock_t view_lock;
+    LcdSnapshot_t view;         //last published state, see lcdpublish
+    wait_queue_head_t change_wq; //pollers waiting for a new generation
+    atomic_t fb_maps;           //number of live mappings of fb
 
     u8 backlight;
     u8 cursor;
@@ -216,13 +434,39 @@ typedef struct LcdDescriptor_t
     u8 display_control;
     u8 display_function;
     u8 show_welcome_screen;
+    u8 busy_flag;               //busy flag polling requested
+    u8 busy_poll;               //busy flag polling works on this backpack and is used
+    u8 redraw;                  //controller content unknown, next flush rewrites every cell
+    u8 shift;                   //display shift, DDRAM line position shown in the first column
     LcdBuffer_t raw_data;
+    LcdBuffer_t back;           //page shown by the next flip, kept in off-screen DDRAM columns
+    u8 back_dirty;              //back differs from what off-screen columns hold
+    u8 ddram[LCD_DDRAM_SIZE];   //what the controller actually holds, indexed by DDRAM address
     CustomChar_t custom_chars[8];
+    u8 cgram_valid;             //bitmask of CGRAM slots known to hold custom_chars
+    LcdGlyphTable_t glyphs;
+    LcdEffects_t effects;
+    LcdCharset_t charset;       //translation of printed text
+    LcdTerm_t term;             //terminal mode of text written to the device
+    LcdStats_t stats;
     char welcome[16];
 } LcdDescriptor_t;
 
+/*
+  DDRAM address of a cell. Column may go past visible columns into the part of DDRAM line
+  which is off the screen, up to LCD_DDRAM_1LINE, display shift moves the visible window
+  along the line.
+*/
+static inline u8 lcdcelladdr(const LcdDescriptor_t *lcd, u8 column, u8 row) {
+    return lcd->tables.addresses[row][column];
+}
+
 void _udelay_(u32 usecs);
+void _ndelay_(u64 nsecs);
+void lcdbegin(LcdDescriptor_t *lcd);
+void lcdend(LcdDescriptor_t *lcd);
 void lcdflushbuffer(LcdDescriptor_t *lcd);
+u8 lcdwriterow(LcdDescriptor_t *lcd, u8 row, u8 column, const u8 *cells, u8 count);
 void lcdcommand(LcdDescriptor_t *lcd, u8 data);
 void lcdwrite(LcdDescriptor_t *lcd, u8 data);
 void lcdsetcursor(LcdDescriptor_t *lcd, u8 column, u8 row);
@@ -230,12 +474,25 @@ void lcdsetbacklight(LcdDescriptor_t *lcd, u8 backlight);
 void lcdcursor(LcdDescriptor_t *lcd, u8 cursor);
 void lcdblink(LcdDescriptor_t *lcd, u8 blink);
 u8 lcdprint(LcdDescriptor_t *lcd, const char *data);
+u8 lcdprintn(LcdDescriptor_t *lcd, const char *data, uint len);
 void lcdfinalize(LcdDescriptor_t *lcd);
 void lcdinit(LcdDescriptor_t *lcd, lcd_topology_t topo);
 void lcdhome(LcdDescriptor_t *lcd);
 void lcdclear(LcdDescriptor_t *lcd);
+void lcdscrollbuffer(LcdDescriptor_t *lcd, const char *line, uint len, u8 direction);
 void lcdscrollvert(LcdDescriptor_t *lcd, const char *line, uint len, u8 direction);
 void lcdscrollhoriz(LcdDescriptor_t *lcd, u8 direction);
+bool lcdcanflip(LcdDescriptor_t *lcd);
+void lcdflushpage(LcdDescriptor_t *lcd);
+int lcdflip(LcdDescriptor_t *lcd);
 void lcdcustomchar(LcdDescriptor_t *lcd, u8 num, const u8 *bitmap);
+void lcdcustomchars(LcdDescriptor_t *lcd, u8 first, u8 count, const CustomChar_t *bitmaps);
+void lcdcustomcharrows(LcdDescriptor_t *lcd, u8 num, const u8 *bitmap);
+int lcdreadstatus(LcdDescriptor_t *lcd, u8 *status);
+u8 lcdbusyprobe(LcdDescriptor_t *lcd);
+int lcdcalibrate(LcdDescriptor_t *lcd);
+void lcdpublish(LcdDescriptor_t *lcd);
+void lcdsnapshot(LcdDescriptor_t *lcd, LcdSnapshot_t *snapshot);
+u64 lcdgeneration(LcdDescriptor_t *lcd);
 
 #endif //LCDI2C_LCDLIB_H
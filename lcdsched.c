@@ -0,0 +1,214 @@
+//
+// Per-adapter bus scheduler shared by all displays on one I2C adapter
+//
+
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/math64.h>
+
+#include "lcdsched.h"
+
+static LIST_HEAD(lcdsched_list);
+static DEFINE_MUTEX(lcdsched_mutex);
+
+/**
+ * attaches a display to the scheduler of its adapter, scheduler is created
+ * when first display on the adapter is attached
+ *
+ * @param LcdSchedClient_t* scheduler client of the display
+ * @param void* adapter the display is connected to
+ * @return int 0 on success, negative error code otherwise
+ *
+ */
+int lcdsched_attach(LcdSchedClient_t *client, const void *adapter) {
+    LcdBusSched_t *bus;
+
+    mutex_lock(&lcdsched_mutex);
+    list_for_each_entry(bus, &lcdsched_list, node) {
+        if (bus->adapter == adapter)
+            goto found;
+    }
+
+    bus = kzalloc(sizeof(LcdBusSched_t), GFP_KERNEL);
+    if (!bus) {
+        mutex_unlock(&lcdsched_mutex);
+        return -ENOMEM;
+    }
+    bus->adapter = adapter;
+    INIT_LIST_HEAD(&bus->clients);
+    spin_lock_init(&bus->lock);
+    init_waitqueue_head(&bus->wq);
+    atomic_set(&bus->waiters, 0);
+    list_add(&bus->node, &lcdsched_list);
+
+found:
+    bus->users++;
+    client->bus = bus;
+    client->waiting = 0;
+    spin_lock(&bus->lock);
+    list_add_tail(&client->node, &bus->clients);
+    spin_unlock(&bus->lock);
+    mutex_unlock(&lcdsched_mutex);
+    return 0;
+}
+
+/**
+ * detaches a display, scheduler goes away with the last display of the adapter
+ *
+ * @param LcdSchedClient_t* scheduler client of the display
+ * @return none
+ *
+ */
+void lcdsched_detach(LcdSchedClient_t *client) {
+    LcdBusSched_t *bus = client->bus;
+
+    if (!bus)
+        return;
+
+    mutex_lock(&lcdsched_mutex);
+    spin_lock(&bus->lock);
+    list_del(&client->node);
+    spin_unlock(&bus->lock);
+    client->bus = NULL;
+    if (!--bus->users) {
+        list_del(&bus->node);
+        kfree(bus);
+    }
+    mutex_unlock(&lcdsched_mutex);
+}
+
+/**
+ * picks the display which gets the bus next: highest priority first,
+ * among equal priorities the one which asked first
+ *
+ * @param LcdBusSched_t* adapter scheduler, lock held
+ * @return LcdSchedClient_t* next display or NULL if nobody waits
+ *
+ */
+static LcdSchedClient_t *_lcdsched_next(LcdBusSched_t *bus) {
+    LcdSchedClient_t *client, *next = NULL;
+
+    list_for_each_entry(client, &bus->clients, node) {
+        if (!client->waiting)
+            continue;
+        if (!next || client->priority > next->priority ||
+            (client->priority == next->priority && client->ticket < next->ticket))
+            next = client;
+    }
+    return next;
+}
+
+/**
+ * hands the bus over to the client if it's free and client is next in line
+ *
+ * @param LcdSchedClient_t* scheduler client of the display
+ * @return bool true if client owns the bus now
+ *
+ */
+static bool _lcdsched_grant(LcdSchedClient_t *client) {
+    LcdBusSched_t *bus = client->bus;
+    bool granted = false;
+
+    spin_lock(&bus->lock);
+    if (!bus->owner && _lcdsched_next(bus) == client) {
+        bus->owner = client;
+        client->waiting = 0;
+        atomic_dec(&bus->waiters);
+        granted = true;
+    }
+    spin_unlock(&bus->lock);
+    return granted;
+}
+
+/**
+ * waits for display's turn on the bus. Has to be paired with lcdsched_release,
+ * every burst between them goes to the bus without traffic of other displays.
+ *
+ * @param LcdSchedClient_t* scheduler client of the display
+ * @return none
+ *
+ */
+void lcdsched_acquire(LcdSchedClient_t *client) {
+    LcdBusSched_t *bus = client->bus;
+    ktime_t now;
+    u64 waited;
+
+    if (!bus)
+        return;
+
+    client->since = ktime_get();
+    spin_lock(&bus->lock);
+    client->ticket = bus->next_ticket++;
+    client->waiting = 1;
+    atomic_inc(&bus->waiters);
+    spin_unlock(&bus->lock);
+
+    wait_event(bus->wq, _lcdsched_grant(client));
+
+    now = ktime_get();
+    waited = ktime_to_ns(ktime_sub(now, client->since));
+    client->since = now;
+    client->grants++;
+    client->wait_ns += waited;
+    client->wait_max_ns = max(client->wait_max_ns, waited);
+}
+
+/**
+ * gives the bus away to the next waiting display
+ *
+ * @param LcdSchedClient_t* scheduler client of the display
+ * @return none
+ *
+ */
+void lcdsched_release(LcdSchedClient_t *client) {
+    LcdBusSched_t *bus = client->bus;
+    u64 held;
+
+    if (!bus)
+        return;
+
+    held = ktime_to_ns(ktime_sub(ktime_get(), client->since));
+
+    spin_lock(&bus->lock);
+    client->busy_ns += held;
+    bus->busy_ns += held;
+    bus->owner = NULL;
+    spin_unlock(&bus->lock);
+
+    if (atomic_read(&bus->waiters))
+        wake_up_all(&bus->wq);
+}
+
+/**
+ * tells whether another display waits for the bus, owner should
+ * end its burst early and release the bus then
+ *
+ * @param LcdSchedClient_t* scheduler client of the display
+ * @return bool true if bus is wanted by someone else
+ *
+ */
+bool lcdsched_contended(LcdSchedClient_t *client) {
+    return client->bus && atomic_read(&client->bus->waiters) > 0;
+}
+
+/**
+ * share of the adapter's bus time used by the display
+ *
+ * @param LcdSchedClient_t* scheduler client of the display
+ * @return uint share in percent
+ *
+ */
+uint lcdsched_share(LcdSchedClient_t *client) {
+    LcdBusSched_t *bus = client->bus;
+    u64 busy, total;
+
+    if (!bus)
+        return 0;
+
+    //64-bit counters aren't read in one go on 32-bit hosts, both are taken under the lock
+    spin_lock(&bus->lock);
+    busy = client->busy_ns;
+    total = bus->busy_ns;
+    spin_unlock(&bus->lock);
+    return total ? (uint) div64_u64(busy * 100, total) : 0;
+}
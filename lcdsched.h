@@ -0,0 +1,60 @@
+//
+// Per-adapter bus scheduler shared by all displays on one I2C adapter
+//
+
+#ifndef LCDI2C_LCDSCHED_H
+#define LCDI2C_LCDSCHED_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/ktime.h>
+
+#define LCD_SCHED_BURST_BYTES (32)     //Burst length when another display on the adapter waits for the bus
+#define LCD_SCHED_DEFAULT_PRIORITY (0)
+#define LCD_SCHED_MAX_PRIORITY (7)
+
+/*
+  One scheduler per I2C adapter. Displays take turns on the bus, a waiting display
+  with higher priority goes first, equal priorities are served in order of request,
+  so displays which yielded queue up behind the others (round robin).
+*/
+typedef struct lcd_bus_sched
+{
+    struct list_head node;      //on the list of all schedulers
+    struct list_head clients;   //displays attached to this adapter
+    const void *adapter;
+    uint users;
+    spinlock_t lock;
+    wait_queue_head_t wq;
+    struct lcd_sched_client *owner;
+    atomic_t waiters;
+    u64 next_ticket;
+    u64 busy_ns;                //bus time granted to all displays
+} LcdBusSched_t;
+
+typedef struct lcd_sched_client
+{
+    LcdBusSched_t *bus;
+    struct list_head node;
+    u64 ticket;                 //order of request among displays of the same priority
+    u8 priority;
+    u8 waiting;
+    ktime_t since;              //when display started waiting, or got the bus
+    u64 grants;
+    u64 bytes;
+    u64 wait_ns;
+    u64 wait_max_ns;
+    u64 busy_ns;
+} LcdSchedClient_t;
+
+int lcdsched_attach(LcdSchedClient_t *client, const void *adapter);
+void lcdsched_detach(LcdSchedClient_t *client);
+void lcdsched_acquire(LcdSchedClient_t *client);
+void lcdsched_release(LcdSchedClient_t *client);
+bool lcdsched_contended(LcdSchedClient_t *client);
+uint lcdsched_share(LcdSchedClient_t *client);
+
+#endif //LCDI2C_LCDSCHED_H
@@ -0,0 +1,98 @@
+//
+// Always-on statistics of a display, counters and log2 latency histograms
+//
+
+#include <linux/string.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+
+#include "lcdlib.h"
+
+/**
+ * clears histogram, lock stays as it is
+ *
+ * @param LcdHistogram_t* histogram
+ * @return none
+ *
+ */
+static void _histreset(LcdHistogram_t *hist) {
+    spin_lock(&hist->lock);
+    memset(hist->buckets, 0, sizeof(hist->buckets));
+    hist->count = 0;
+    hist->sum_ns = 0;
+    hist->max_ns = 0;
+    spin_unlock(&hist->lock);
+}
+
+/**
+ * prepares statistics of a new display, structure has to be zeroed before
+ *
+ * @param LcdStats_t* statistics
+ * @return none
+ *
+ */
+void lcdstats_init(LcdStats_t *stats) {
+    spin_lock_init(&stats->flush.lock);
+    spin_lock_init(&stats->ioctl.lock);
+    spin_lock_init(&stats->lock_wait.lock);
+}
+
+/**
+ * zeroes all counters and histograms.
+ * Caller has to hold the semaphore.
+ *
+ * @param LcdStats_t* statistics
+ * @return none
+ *
+ */
+void lcdstats_reset(LcdStats_t *stats) {
+    stats->transactions = 0;
+    stats->bytes = 0;
+    stats->failures = 0;
+    stats->flushes = 0;
+    stats->cells = 0;
+    stats->cgram_uploads = 0;
+    stats->bus_ns = 0;
+    stats->delays = 0;
+    stats->delay_ns = 0;
+    _histreset(&stats->flush);
+    _histreset(&stats->ioctl);
+    _histreset(&stats->lock_wait);
+}
+
+/**
+ * adds a latency to the histogram
+ *
+ * @param LcdHistogram_t* histogram
+ * @param u64 latency in nanoseconds
+ * @return none
+ *
+ */
+void lcdstats_record(LcdHistogram_t *hist, u64 nsecs) {
+    const uint bucket = min_t(uint, fls64(div_u64(nsecs, NSEC_PER_USEC)), LCD_STATS_BUCKETS - 1);
+
+    spin_lock(&hist->lock);
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum_ns += nsecs;
+    if (nsecs > hist->max_ns)
+        hist->max_ns = nsecs;
+    spin_unlock(&hist->lock);
+}
+
+/**
+ * copies histogram consistently, so readers see buckets which add up to count
+ *
+ * @param LcdHistogram_t* histogram
+ * @param LcdHistogram_t* where to store the copy, its lock is left alone
+ * @return none
+ *
+ */
+void lcdstats_snapshot(LcdHistogram_t *hist, LcdHistogram_t *copy) {
+    spin_lock(&hist->lock);
+    memcpy(copy->buckets, hist->buckets, sizeof(copy->buckets));
+    copy->count = hist->count;
+    copy->sum_ns = hist->sum_ns;
+    copy->max_ns = hist->max_ns;
+    spin_unlock(&hist->lock);
+}
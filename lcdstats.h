@@ -0,0 +1,50 @@
+//
+// Always-on statistics of a display, counters and log2 latency histograms
+//
+
+#ifndef LCDI2C_LCDSTATS_H
+#define LCDI2C_LCDSTATS_H
+
+#include <linux/types.h>
+#include <linux/spinlock.h>
+
+#define LCD_STATS_BUCKETS (24)     //log2 buckets in microseconds, the last one is open-ended (4.2s and more)
+
+/*
+  Histogram of latencies, bucket 0 counts latencies under 1us, bucket n those
+  from 2^(n-1) to 2^n us. Recorded from any context, hence the lock.
+*/
+typedef struct lcd_histogram
+{
+    spinlock_t lock;
+    u64 buckets[LCD_STATS_BUCKETS];
+    u64 count;
+    u64 sum_ns;
+    u64 max_ns;
+} LcdHistogram_t;
+
+/*
+  Counters are updated with the display semaphore held, reset takes it too
+*/
+typedef struct lcd_stats
+{
+    u64 transactions;           //I2C transfers and SMBus calls
+    u64 bytes;                  //bytes moved over the bus, both directions
+    u64 failures;               //failed transfers
+    u64 flushes;                //flushes of the screen buffer and of the back page
+    u64 cells;                  //data bytes sent by flushes
+    u64 cgram_uploads;          //custom characters (re)defined in CGRAM
+    u64 bus_ns;                 //time spent in transfers
+    u64 delays;                 //waits for the controller to finish an instruction
+    u64 delay_ns;
+    LcdHistogram_t flush;       //lcdflushbuffer and lcdflushpage
+    LcdHistogram_t ioctl;
+    LcdHistogram_t lock_wait;   //waits for the display semaphore
+} LcdStats_t;
+
+void lcdstats_init(LcdStats_t *stats);
+void lcdstats_reset(LcdStats_t *stats);
+void lcdstats_record(LcdHistogram_t *hist, u64 nsecs);
+void lcdstats_snapshot(LcdHistogram_t *hist, LcdHistogram_t *copy);
+
+#endif //LCDI2C_LCDSTATS_H
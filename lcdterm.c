@@ -0,0 +1,406 @@
+//
+// Terminal mode, a VT100 subset interpreted in text written to the device
+//
+
+#include <linux/string.h>
+
+#include "lcdlib.h"
+
+#define ESC (0x1B)
+
+/**
+ * forgets escape sequence being parsed and saved cursor, mode stays as it is
+ *
+ * @param LcdTerm_t* terminal state
+ * @return none
+ *
+ */
+void lcdterm_reset(LcdTerm_t *term) {
+    const u8 enabled = term->enabled;
+
+    memset(term, 0, sizeof(LcdTerm_t));
+    term->enabled = enabled;
+}
+
+/**
+ * numeric parameter of CSI sequence, missing or 0 gives the default
+ *
+ * @param LcdTerm_t* terminal state
+ * @param u8 parameter number
+ * @param u8 default value
+ * @return u8 parameter value, at most 255
+ *
+ */
+static u8 _param(const LcdTerm_t *term, u8 i, u8 def) {
+    if (i >= term->nparams || !term->params[i])
+        return def;
+    return min_t(u16, term->params[i], 255);
+}
+
+/**
+ * moves cursor, position out of the screen is clamped to its edge
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param int column
+ * @param int row
+ * @return none
+ *
+ */
+static void _moveto(LcdDescriptor_t *lcd, int column, int row) {
+    lcd->column = clamp_t(int, column, 0, lcd->organization.columns - 1);
+    lcd->row = clamp_t(int, row, 0, lcd->organization.rows - 1);
+    lcd->term.wrap = 0;
+}
+
+/**
+ * moves cursor one row down, at the bottom row content scrolls up instead
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @return none
+ *
+ */
+static void _linefeed(LcdDescriptor_t *lcd) {
+    if (lcd->row + 1 < lcd->organization.rows)
+        lcd->row++;
+    else
+        lcdscrollbuffer(lcd, "", 0, 0);
+    lcd->term.wrap = 0;
+}
+
+/**
+ * fills cells from one offset in raw_data to another with spaces
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param uint first cell
+ * @param uint cell after the last one
+ * @return none
+ *
+ */
+static void _erase(LcdDescriptor_t *lcd, uint from, uint to) {
+    if (to > from)
+        memset(lcd->raw_data + from, ' ', to - from);
+}
+
+/**
+ * puts character codes at the cursor, wrapping to the next row and
+ * scrolling at the bottom
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8* character codes
+ * @param uint number of codes
+ * @return none
+ *
+ */
+static void _putcells(LcdDescriptor_t *lcd, const u8 *cells, uint count) {
+    const u8 columns = lcd->organization.columns;
+    uint i;
+
+    for (i = 0; i < count; i++) {
+        if (lcd->term.wrap) {
+            lcd->column = 0;
+            _linefeed(lcd);
+        }
+        lcd->raw_data[lcd->row * columns + lcd->column] = cells[i];
+        if (lcd->column + 1 < columns)
+            lcd->column++;
+        else
+            lcd->term.wrap = 1;
+    }
+}
+
+/**
+ * puts text at the cursor, translated to character codes unless
+ * display's character set is raw
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8* text without control codes
+ * @param uint number of bytes
+ * @return none
+ *
+ */
+static void _print(LcdDescriptor_t *lcd, const u8 *data, uint len) {
+    u8 cells[LCD_BUFFER_SIZE];
+    uint used, count;
+
+    if (lcd->charset.mode == LCD_CHARSET_RAW) {
+        _putcells(lcd, data, len);
+        return;
+    }
+    while (len) {
+        count = lcdcharset_translate(lcd, data, len, cells, sizeof(cells), &used);
+        _putcells(lcd, cells, count);
+        data += used;
+        len -= used;
+    }
+}
+
+/**
+ * puts registered glyph at the cursor, glyph is loaded into CGRAM if it
+ * isn't there already
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 glyph id
+ * @return none
+ *
+ */
+static void _putglyph(LcdDescriptor_t *lcd, u8 id) {
+    u8 code = LCD_CHARSET_REPLACEMENT;
+
+    if (lcdglyph_registered(&lcd->glyphs, id) && lcdglyph_map(lcd, &id, 1, &code))
+        code = LCD_CHARSET_REPLACEMENT;
+    _putcells(lcd, &code, 1);
+}
+
+/**
+ * executes control code
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 control code
+ * @return none
+ *
+ */
+static void _control(LcdDescriptor_t *lcd, u8 code) {
+    switch (code) {
+        case '\b':
+            _moveto(lcd, lcd->column - 1, lcd->row);
+            break;
+        case '\t':
+            _moveto(lcd, (lcd->column / LCD_TERM_TAB + 1) * LCD_TERM_TAB, lcd->row);
+            break;
+        case '\n':
+        case '\v':
+        case '\f':
+            //newline, as lcdprint does it, cursor goes to the start of the next row
+            lcd->column = 0;
+            _linefeed(lcd);
+            break;
+        case '\r':
+            _moveto(lcd, 0, lcd->row);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * executes escape sequence ESC <code>
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 byte which follows ESC
+ * @return none
+ *
+ */
+static void _escape(LcdDescriptor_t *lcd, u8 code) {
+    LcdTerm_t *term = &lcd->term;
+
+    switch (code) {
+        case '7':       //DECSC
+            term->saved_column = lcd->column;
+            term->saved_row = lcd->row;
+            break;
+        case '8':       //DECRC
+            _moveto(lcd, term->saved_column, term->saved_row);
+            break;
+        case 'D':       //IND
+            _linefeed(lcd);
+            break;
+        case 'E':       //NEL
+            lcd->column = 0;
+            _linefeed(lcd);
+            break;
+        case 'M':       //RI
+            if (lcd->row > 0)
+                _moveto(lcd, lcd->column, lcd->row - 1);
+            else
+                lcdscrollbuffer(lcd, "", 0, 1);
+            break;
+        case 'c':       //RIS
+            lcdterm_reset(term);
+            memset(lcd->raw_data, ' ', LCD_BUFFER_SIZE);
+            _moveto(lcd, 0, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * executes CSI sequence ESC [ <parameters> <final>
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8 final byte
+ * @return none
+ *
+ */
+static void _csi(LcdDescriptor_t *lcd, u8 final) {
+    LcdTerm_t *term = &lcd->term;
+    const u8 columns = lcd->organization.columns;
+    const uint cursor = lcd->row * columns + lcd->column;
+    const uint line = lcd->row * columns;
+    const uint cells = lcd->organization.rows * columns;
+    u8 n = _param(term, 0, 1);
+
+    if (term->private) {
+        //DEC private modes, cursor and its blinking
+        if (term->private != '?' || (final != 'h' && final != 'l'))
+            return;
+        if (_param(term, 0, 0) == 25) {
+            lcd->cursor = final == 'h';
+            lcdcursor(lcd, lcd->cursor);
+        } else if (_param(term, 0, 0) == 12) {
+            lcd->blink = final == 'h';
+            lcdblink(lcd, lcd->blink);
+        }
+        return;
+    }
+
+    switch (final) {
+        case 'A':       //CUU
+            _moveto(lcd, lcd->column, lcd->row - n);
+            break;
+        case 'B':       //CUD
+        case 'e':       //VPR
+            _moveto(lcd, lcd->column, lcd->row + n);
+            break;
+        case 'C':       //CUF
+        case 'a':       //HPR
+            _moveto(lcd, lcd->column + n, lcd->row);
+            break;
+        case 'D':       //CUB
+            _moveto(lcd, lcd->column - n, lcd->row);
+            break;
+        case 'E':       //CNL
+            _moveto(lcd, 0, lcd->row + n);
+            break;
+        case 'F':       //CPL
+            _moveto(lcd, 0, lcd->row - n);
+            break;
+        case 'G':       //CHA
+        case '`':       //HPA
+            _moveto(lcd, n - 1, lcd->row);
+            break;
+        case 'd':       //VPA
+            _moveto(lcd, lcd->column, n - 1);
+            break;
+        case 'H':       //CUP
+        case 'f':       //HVP
+            _moveto(lcd, _param(term, 1, 1) - 1, n - 1);
+            break;
+        case 'J':       //ED
+            n = _param(term, 0, 0);
+            _erase(lcd, n == 0 ? cursor : 0, n == 1 ? cursor + 1 : cells);
+            break;
+        case 'K':       //EL
+            n = _param(term, 0, 0);
+            _erase(lcd, n == 0 ? cursor : line, n == 1 ? cursor + 1 : line + columns);
+            break;
+        case 'S':       //SU
+        case 'T':       //SD
+            for (n = min_t(u8, n, lcd->organization.rows); n; n--)
+                lcdscrollbuffer(lcd, "", 0, final == 'T');
+            break;
+        case 's':       //SCOSC
+            term->saved_column = lcd->column;
+            term->saved_row = lcd->row;
+            break;
+        case 'u':       //SCORC
+            _moveto(lcd, term->saved_column, term->saved_row);
+            break;
+        case 'y':       //private, registered glyph
+            _putglyph(lcd, _param(term, 0, 0));
+            break;
+        case 'z':       //private, character code as it is
+            n = _param(term, 0, 0);
+            _putcells(lcd, &n, 1);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * interprets text written in terminal mode: printable text goes to the
+ * cursor, control codes and escape sequences of a VT100 subset move the
+ * cursor, erase, scroll or insert custom characters. Only raw_data and
+ * cursor are changed, caller flushes raw_data, so everything written at
+ * once goes to the LCD as runs of changed cells, one DDRAM address set
+ * per run.
+ * Caller has to hold the semaphore.
+ *
+ * @param LcdData_t* lcd handler structure address
+ * @param u8* data written
+ * @param uint number of bytes
+ * @return none
+ *
+ */
+void lcdterm_write(LcdDescriptor_t *lcd, const u8 *data, uint len) {
+    LcdTerm_t *term = &lcd->term;
+    uint i, start;
+    u8 byte;
+
+    for (i = 0; i < len; i++) {
+        byte = data[i];
+
+        //ESC starts a new sequence and CAN, SUB cancel one, whatever state parser is in
+        if (byte == ESC) {
+            term->state = LCD_TERM_ESCAPE;
+            continue;
+        }
+        if (byte == 0x18 || byte == 0x1A) {
+            term->state = LCD_TERM_GROUND;
+            continue;
+        }
+
+        switch (term->state) {
+            case LCD_TERM_GROUND:
+                if (byte < 0x20) {
+                    _control(lcd, byte);
+                    break;
+                }
+                for (start = i; i + 1 < len && data[i + 1] >= 0x20; i++);
+                _print(lcd, data + start, i - start + 1);
+                break;
+            case LCD_TERM_ESCAPE:
+                if (byte == '[') {
+                    term->state = LCD_TERM_CSI;
+                    term->private = 0;
+                    term->ignore = 0;
+                    term->nparams = 0;
+                    memset(term->params, 0, sizeof(term->params));
+                    break;
+                }
+                term->state = LCD_TERM_GROUND;
+                _escape(lcd, byte);
+                break;
+            case LCD_TERM_CSI:
+                if (byte < 0x20) {
+                    //control codes are executed in the middle of a sequence too
+                    _control(lcd, byte);
+                } else if (byte >= '0' && byte <= '9') {
+                    if (!term->nparams)
+                        term->nparams = 1;
+                    term->params[term->nparams - 1] = min_t(u16, term->params[term->nparams - 1] * 10 + byte - '0',
+                                                            LCD_TERM_PARAM_MAX);
+                } else if (byte == ';') {
+                    if (!term->nparams)
+                        term->nparams = 1;
+                    if (term->nparams < LCD_TERM_PARAMS)
+                        term->nparams++;
+                    else
+                        term->ignore = 1;
+                } else if (byte >= 0x3C && byte <= 0x3F) {
+                    term->private = byte;
+                } else if (byte >= 0x20 && byte <= 0x2F) {
+                    term->ignore = 1;
+                } else {
+                    term->state = LCD_TERM_GROUND;
+                    if (byte >= 0x40 && byte <= 0x7E && !term->ignore)
+                        _csi(lcd, byte);
+                }
+                break;
+            default:
+                term->state = LCD_TERM_GROUND;
+                break;
+        }
+    }
+}
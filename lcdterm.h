@@ -0,0 +1,44 @@
+//
+// Terminal mode, a VT100 subset interpreted in text written to the device
+//
+
+#ifndef LCDI2C_LCDTERM_H
+#define LCDI2C_LCDTERM_H
+
+#include <linux/types.h>
+
+#define LCD_TERM_PARAMS (4)             //CSI parameters kept, sequences with more are ignored
+#define LCD_TERM_PARAM_MAX (9999)
+#define LCD_TERM_TAB (8)                //tab stops every 8 columns
+
+typedef enum lcd_term_state {
+    LCD_TERM_GROUND = 0,        //text and control codes
+    LCD_TERM_ESCAPE,            //after ESC
+    LCD_TERM_CSI,               //after ESC [, parameters until the final byte
+} lcd_term_state_t;
+
+/*
+  Parser state of a display in terminal mode. Escape sequence split between two writes
+  is completed by the next one. Cursor is column and row of the display, wrap is set
+  once a character lands in the last column, so the next one starts a new line, the way
+  VT100 does it, and a full row followed by a newline doesn't leave an empty one.
+*/
+typedef struct lcd_term
+{
+    u8 enabled;
+    u8 state;                   //lcd_term_state_t
+    u8 private;                 //private marker of CSI sequence, '?' for DEC modes
+    u8 ignore;                  //CSI sequence has intermediates or too many parameters
+    u8 nparams;
+    u16 params[LCD_TERM_PARAMS];
+    u8 wrap;                    //cursor is past the last column
+    u8 saved_column;            //cursor saved by ESC 7 or CSI s
+    u8 saved_row;
+} LcdTerm_t;
+
+struct LcdDescriptor_t;
+
+void lcdterm_reset(LcdTerm_t *term);
+void lcdterm_write(struct LcdDescriptor_t *lcd, const u8 *data, uint len);
+
+#endif //LCDI2C_LCDTERM_H
@@ -12,15 +12,32 @@
 
 import array
 import fcntl
+import os
+import select
 import sys
 
 import yaml
 
-from ctypes import c_char, c_bool, c_uint8, c_uint32, Structure
+from ctypes import addressof, c_char, c_bool, c_int32, c_uint8, c_uint16, c_uint32, c_uint64, Structure
 from enum import Enum
 from typing import Tuple, Iterable, ByteString
 
-META_FILE_PATH = "/sys/class/alphalcd/lcdi2c/meta"
+CLASS_PATH = "/sys/class/alphalcd"
+DEVICE_PREFIX = "lcdi2c"
+
+
+def device_name(bus: int = None, address: int = None) -> str:
+    """
+    Returns name of the display device at given bus and address, as used in /dev and /sys/class/alphalcd.
+    Without bus and address returns the first display registered by the driver.
+    """
+    if bus is not None and address is not None:
+        return f"{DEVICE_PREFIX}-{bus}-{address:02x}"
+    try:
+        names = sorted(n for n in os.listdir(CLASS_PATH) if n.startswith(f"{DEVICE_PREFIX}-"))
+    except FileNotFoundError:
+        names = []
+    return names[0] if names else None
 
 
 class LCDMisc(Enum):
@@ -143,6 +160,104 @@ class LCDCustomCharArgs(Structure):
             self.data = array.array("B", data).tobytes()
 
 
+class LCDCommitArgs(Structure):
+    """
+    Structure for COMMIT IOCTL argument, damage rectangle of mmap()ed framebuffer.
+    Rectangle with zero columns or rows commits the whole screen.
+    """
+    _fields_ = [
+        ("column", c_uint8),
+        ("row", c_uint8),
+        ("columns", c_uint8),
+        ("rows", c_uint8),
+    ]
+
+    def __init__(self, column: int = None, row: int = None, columns: int = None, rows: int = None):
+        super().__init__()
+        if column is not None:
+            self.column = column
+        if row is not None:
+            self.row = row
+        if columns is not None:
+            self.columns = columns
+        if rows is not None:
+            self.rows = rows
+
+
+class LCDWindowArgs(Structure):
+    """
+    Structure for SETWINDOW IOCTL argument, region of the screen claimed by the open file.
+    Zero columns and rows give the whole screen back.
+    """
+    _fields_ = [
+        ("column", c_uint8),
+        ("row", c_uint8),
+        ("columns", c_uint8),
+        ("rows", c_uint8),
+    ]
+
+    def __init__(self, column: int = None, row: int = None, columns: int = None, rows: int = None):
+        super().__init__()
+        if column is not None:
+            self.column = column
+        if row is not None:
+            self.row = row
+        if columns is not None:
+            self.columns = columns
+        if rows is not None:
+            self.rows = rows
+
+
+class LCDBatchOp(Structure):
+    """
+    Single operation of BATCH IOCTL. Op codes are in LCDBatchOpCode, status is set by the driver.
+    """
+    _fields_ = [
+        ("op", c_uint8),
+        ("column", c_uint8),
+        ("row", c_uint8),
+        ("value", c_uint8),
+        ("status", c_int32),
+        ("data", c_char * LCDMisc.LCD_LINE_LEN.value),
+    ]
+
+
+class LCDBatchOpCode(Enum):
+    """
+    Operation codes of BATCH IOCTL.
+    """
+    POSITION = 1
+    TEXT = 2
+    LINE = 3
+    CUSTOMCHAR = 4
+    BACKLIGHT = 5
+    CURSOR = 6
+    BLINK = 7
+    CLEAR = 8
+    GLYPHS = 9
+
+
+class LCDBatchArgs(Structure):
+    """
+    Structure for BATCH IOCTL argument, ops is the address of LCDBatchOp array.
+    Column and row are set by the driver to the cursor position after the batch.
+    """
+    _fields_ = [
+        ("count", c_uint32),
+        ("column", c_uint8),
+        ("row", c_uint8),
+        ("reserved", c_uint8 * 2),
+        ("ops", c_uint64),
+    ]
+
+    def __init__(self, count: int = None, ops: int = None):
+        super().__init__()
+        if count is not None:
+            self.count = count
+        if ops is not None:
+            self.ops = ops
+
+
 class LCDCommand(Enum):
     """
     LCDCommand class contains all IOCTL names used for communication with the driver.
@@ -169,6 +284,16 @@ class LCDCommand(Enum):
     CLEAR = "CLEAR"
     SET_POSITION = "SETPOSITION"
     GET_POSITION = "GETPOSITION"
+    SYNC = "SYNC"
+    COMMIT = "COMMIT"
+    BATCH = "BATCH"
+    GET_STATE = "GETSTATE"
+    SET_GLYPH = "SETGLYPH"
+    ANIMATE = "ANIMATE"
+    MARQUEE = "MARQUEE"
+    SET_PAGE = "SETPAGE"
+    FLIP = "FLIP"
+    SET_WINDOW = "SETWINDOW"
 
     def __init__(self, ioctl_name):
         self.ioctl_name = ioctl_name
@@ -187,6 +312,89 @@ class LCDDirection(Enum):
     WRITEREAD = 3
 
 
+class LCDStateArgs(Structure):
+    """
+    Structure for GETSTATE IOCTL argument, whole published state of the display and its generation.
+    Generation grows whenever content, cursor or custom characters change.
+    """
+    _fields_ = [
+        ("generation", c_uint64),
+        ("buffer", c_char * LCDMisc.LCD_BUFFER_LEN.value),
+        ("custom_chars", (c_uint8 * 8) * 8),
+        ("column", c_uint8),
+        ("row", c_uint8),
+        ("backlight", c_uint8),
+        ("cursor", c_uint8),
+        ("blink", c_uint8),
+        ("reserved", c_uint8 * 7),
+    ]
+
+
+class LCDGlyphArgs(Structure):
+    """
+    Structure for SETGLYPH IOCTL argument, glyph of the virtual glyph table.
+    With AUTO flag driver picks the id and returns it in id, REMOVE flag forgets the glyph.
+    """
+    AUTO = 1
+    REMOVE = 2
+
+    _fields_ = [
+        ("id", c_uint8),
+        ("flags", c_uint8),
+        ("reserved", c_uint8 * 2),
+        ("bitmap", c_char * 8),
+    ]
+
+    def __init__(self, id: int = None, flags: int = None, bitmap: Iterable[int] = None):
+        super().__init__()
+        if id is not None:
+            self.id = id
+        if flags is not None:
+            self.flags = flags
+        if bitmap is not None:
+            self.bitmap = array.array("B", bitmap).tobytes()
+
+
+class LCDAnimationArgs(Structure):
+    """
+    Structure for ANIMATE IOCTL argument. LOAD uploads frames of CGRAM slot with duration
+    of every frame in milliseconds and starts the animation, START restarts frames loaded before,
+    STOP stops the animation. Animation runs loops times, 0 means forever.
+    """
+    STOP = 0
+    LOAD = 1
+    START = 2
+    MAX_FRAMES = 16
+
+    _fields_ = [
+        ("slot", c_uint8),
+        ("command", c_uint8),
+        ("frames", c_uint8),
+        ("reserved", c_uint8),
+        ("loops", c_uint16),
+        ("reserved2", c_uint8 * 2),
+        ("duration_ms", c_uint16 * MAX_FRAMES),
+        ("bitmaps", (c_uint8 * 8) * MAX_FRAMES),
+    ]
+
+
+class LCDMarqueeArgs(Structure):
+    """
+    Structure for MARQUEE IOCTL argument. Text of length bytes at address text scrolls
+    through the row by one column every step_ms milliseconds, direction 0 moves it left,
+    1 - right. Length 0 stops the marquee of the row.
+    """
+    MAX_TEXT = 4096
+
+    _fields_ = [
+        ("row", c_uint8),
+        ("direction", c_uint8),
+        ("step_ms", c_uint16),
+        ("length", c_uint32),
+        ("text", c_uint64),
+    ]
+
+
 # IOCTL format dictionary, contains IOCTL format string determines length in bytes for each
 # IOCTL argument structure. First element contains format string used by struct.pack/unpack functions
 # Second element is the argument structure class used in call.
@@ -213,6 +421,16 @@ IOCTLFMT = {
     LCDCommand.HOME: ("0B", None),
     LCDCommand.CLEAR: ("0B", None),
     LCDCommand.GET_VERSION: ("0B", None),
+    LCDCommand.SYNC: ("0B", None),
+    LCDCommand.COMMIT: ("4B", LCDCommitArgs),
+    LCDCommand.BATCH: ("1L4B1Q", LCDBatchArgs),
+    LCDCommand.GET_STATE: (f"1Q{LCDMisc.LCD_BUFFER_LEN.value}B64B5B7B", LCDStateArgs),
+    LCDCommand.SET_GLYPH: ("4B8B", LCDGlyphArgs),
+    LCDCommand.ANIMATE: ("4B1H2B16H128B", LCDAnimationArgs),
+    LCDCommand.MARQUEE: ("2B1H1L1Q", LCDMarqueeArgs),
+    LCDCommand.SET_PAGE: (f"{LCDMisc.LCD_BUFFER_LEN.value}B", LCDBufferArgs),
+    LCDCommand.FLIP: ("0B", None),
+    LCDCommand.SET_WINDOW: ("4B", LCDWindowArgs),
 }
 
 
@@ -382,28 +600,29 @@ class AlphaLCD:
         self.rows = 0
         self.columns = 0
         self.calculated_buffer_length = 0
+        self.charset = "raw"
         self.bus = bus
         self.address = address
 
+        name = device_name(bus, address)
+        if name is None:
+            raise AlphaLCDInitError(f"No display found in {CLASS_PATH} (is the lcdi2c module loaded?)")
+        self.meta_path = f"{CLASS_PATH}/{name}/meta"
+        self.device_path = f"/dev/{name}"
+
         try:
-            with open(META_FILE_PATH) as meta:
+            with open(self.meta_path) as meta:
                 p = yaml.safe_load(meta)
                 self.columns = p["metadata"]["columns"]
                 self.rows = p["metadata"]["rows"]
                 self.ioctl_manager = IOCTLManager(p["metadata"]["ioctls"])
                 self.buffer_length = p["metadata"]["raw_data-len"]
-                if not (bus or address):
-                    self.bus = p["metadata"]["busno"]
-                    self.address = p["metadata"]["reg"]
+                self.bus = p["metadata"]["busno"]
+                self.address = p["metadata"]["reg"]
+                self.charset = p["metadata"].get("charset", "raw")
                 self.calculated_buffer_length = self.columns * self.rows
         except FileNotFoundError:
-            raise AlphaLCDInitError(f"Metadata file not found at {META_FILE_PATH} (is the lcdi2c module loaded?)")
-
-        try:
-            with open(f"/sys/bus/i2c/devices/{self.bus}-{self.address:04x}/name") as f:
-                self.device_path = f"/dev/{f.read().strip()}"
-        except FileNotFoundError:
-            raise AlphaLCDInitError(f"Device not found at bus {self.bus} address {self.address}")
+            raise AlphaLCDInitError(f"Metadata file not found at {self.meta_path} (is the lcdi2c module loaded?)")
 
     def __call__(self, ioctl_name: str, **kwargs):
         return self.ioctl_manager(ioctl_name, self.file, **kwargs)
@@ -417,7 +636,9 @@ class AlphaLCD:
         return isinstance(value, TypeError)
 
     def open(self):
-        self.file = open(file=self.device_path, mode=self.mode)
+        # driver translates UTF-8 text itself unless its charset is raw
+        self.file = open(file=self.device_path, mode=self.mode,
+                         encoding=None if self.charset == "raw" else "utf-8")
         if self.file:
             self.closed = False
         return self.file
@@ -435,6 +656,96 @@ class AlphaLCD:
     def flush(self):
         return 0 if self.closed else self.file.flush()
 
+    def batch(self, ops: Iterable[LCDBatchOp]) -> Tuple[Tuple[int, ...], Tuple[int, int]]:
+        """
+        Execute operations in a single BATCH IOCTL, all of them or none if any is invalid.
+        :param ops: LCDBatchOp structures
+        :return: status of each operation and cursor position after the batch
+        """
+        ops = list(ops)
+        array_ops = (LCDBatchOp * len(ops))(*ops)
+        args = LCDBatchArgs(count=len(ops), ops=addressof(array_ops))
+        self.flush()
+        try:
+            fcntl.ioctl(self.file, self.ioctl_manager.ioctls[LCDCommand.BATCH.value].ioctl_value, args, True)
+        except OSError as e:
+            raise AlphaLCDIOError(f"Batch failed, statuses: {[op.status for op in array_ops]}") from e
+        return tuple(op.status for op in array_ops), (args.column, args.row)
+
+    def register_glyph(self, bitmap: Iterable[int], id: int = None) -> int:
+        """
+        Register glyph in the virtual glyph table of the driver, glyphs are put on the screen
+        with GLYPHS batch operation.
+        :param bitmap: 8 bytes of bitmap definition
+        :param id: glyph id 0-255, None lets the driver pick it, reusing identical glyph
+        :return: glyph id
+        """
+        args = LCDGlyphArgs(id=id or 0, flags=LCDGlyphArgs.AUTO if id is None else 0, bitmap=bitmap)
+        fcntl.ioctl(self.file, self.ioctl_manager.ioctls[LCDCommand.SET_GLYPH.value].ioctl_value, args, True)
+        return args.id
+
+    def animate(self, slot: int, frames: Iterable[Iterable[int]] = None, durations: Iterable[int] = None,
+                loops: int = 0) -> None:
+        """
+        Animate custom character, driver shows the frames on its own.
+        :param slot: custom character number 0-7
+        :param frames: bitmaps of frames, 8 bytes each, None restarts frames loaded before
+        :param durations: duration of every frame in milliseconds
+        :param loops: number of runs, 0 - forever
+        """
+        args = LCDAnimationArgs(slot=slot, command=LCDAnimationArgs.START, loops=loops)
+        if frames is not None:
+            frames = list(frames)
+            args.command = LCDAnimationArgs.LOAD
+            args.frames = len(frames)
+            for i, (bitmap, duration) in enumerate(zip(frames, durations)):
+                args.bitmaps[i][:] = list(bitmap)
+                args.duration_ms[i] = duration
+        fcntl.ioctl(self.file, self.ioctl_manager.ioctls[LCDCommand.ANIMATE.value].ioctl_value, args)
+
+    def stop_animation(self, slot: int) -> None:
+        """
+        Stop animation of custom character, current frame stays.
+        :param slot: custom character number 0-7
+        """
+        args = LCDAnimationArgs(slot=slot, command=LCDAnimationArgs.STOP)
+        fcntl.ioctl(self.file, self.ioctl_manager.ioctls[LCDCommand.ANIMATE.value].ioctl_value, args)
+
+    def marquee(self, row: int, text: ByteString = b"", step_ms: int = 300, direction: int = 0) -> None:
+        """
+        Scroll text through the row, driver moves it on its own. Text shorter than the row
+        is followed by spaces.
+        :param row: row number
+        :param text: text to scroll, empty stops the marquee, what's shown stays
+        :param step_ms: milliseconds between steps, 50 at least
+        :param direction: 0 - text moves left, 1 - right
+        """
+        text = bytes(text)
+        buffer = (c_uint8 * max(len(text), 1)).from_buffer_copy(text or b"\0")
+        args = LCDMarqueeArgs(row=row, direction=direction, step_ms=step_ms, length=len(text),
+                              text=addressof(buffer))
+        fcntl.ioctl(self.file, self.ioctl_manager.ioctls[LCDCommand.MARQUEE.value].ioctl_value, args)
+
+    def state(self) -> LCDStateArgs:
+        """
+        Get published state of the display with its generation. Device file becomes readable
+        for poll() again only after the generation changes.
+        """
+        args = LCDStateArgs()
+        fcntl.ioctl(self.file, self.ioctl_manager.ioctls[LCDCommand.GET_STATE.value].ioctl_value, args, True)
+        return args
+
+    def wait_change(self, timeout: float = None) -> bool:
+        """
+        Wait until content of the display changes.
+        :param timeout: seconds to wait, None waits forever
+        :return: True if content changed, False on timeout
+        """
+        poller = select.poll()
+        poller.register(self.file, select.POLLIN)
+        return bool(poller.poll(None if timeout is None else int(timeout * 1000)))
+
+
 
 class LCDCursor:
     """
@@ -700,6 +1011,35 @@ class LCDPrint:
         """
         self.lcd(LCDCommand.SET_BUFFER.value, buffer=data)
 
+    def set_page(self, data: str) -> None:
+        """
+        Prepare the next page, laid out like the buffer. It is sent off the screen while the current
+        page stays visible, works on 2-row displays up to 20 columns only.
+        :param data:
+        :return:
+        """
+        self.lcd(LCDCommand.SET_PAGE.value, buffer=data)
+
+    def flip(self) -> None:
+        """
+        Show the page prepared by set_page, the page shown so far becomes the next one.
+        :return:
+        """
+        self.lcd(LCDCommand.FLIP.value)
+
+    def set_window(self, column: int = 0, row: int = 0, columns: int = 0, rows: int = 0) -> None:
+        """
+        Claim a region of the screen for this open file. Writes, cursor position, home and clear
+        work within the region from now on, with the cursor of this file. Zero columns and rows
+        give the whole screen back.
+        :param column: first column of the region
+        :param row: first row of the region
+        :param columns: number of columns
+        :param rows: number of rows
+        :return:
+        """
+        self.lcd(LCDCommand.SET_WINDOW.value, column=column, row=row, columns=columns, rows=rows)
+
     def __enter__(self) -> "LCDPrint":
         self.lcd.open()
         return self